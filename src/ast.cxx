@@ -1,10 +1,33 @@
 #include "ast.hxx"
+#include "batch.hxx"
+#include "cache.hxx"
+#include "columnar.hxx"
+#include "contract.hxx"
+#include "csv.hxx"
+#include "diskcache.hxx"
+#include "egraph.hxx"
+#include "flatten.hxx"
+#include "hash.hxx"
+#include "output.hxx"
+#include "parser.hxx"
+#include "pipeline.hxx"
+#include "polynomial.hxx"
+#include "program.hxx"
+#include "reassociate.hxx"
+#include "serialize.hxx"
+#include "shared.hxx"
+#include "simplify.hxx"
+#include "solver.hxx"
+#include "specialize.hxx"
+#include "uring.hxx"
+#include <cstddef>
+#include <cstdlib>
 #include <cstring>
 
-#ifdef ENABLE_TESTS
-
 // Static initialization of variableTable in Identifier class.
-std::unordered_map<std::string, double> Identifier::variableTable;
+VariableStore Identifier::variableTable;
+
+#ifdef ENABLE_TESTS
 
 // Include the header file with ASTNode classes here
 
@@ -94,6 +117,933 @@ void testIdentifierUndefinedVariable() {
     // Note: The error message is not captured in this simple example.
 }
 
+// Test NewtonSolver on a square nonlinear system with a parameter from the variable table
+void testNewtonSolver() {
+    // x^2 + y^2 - r = 0 and x - y = 0, solved for x = y = sqrt(r / 2).
+    Identifier::setVariable("r", 8.0);
+    Subtract circle(std::make_unique<Add>(std::make_unique<Power>(std::make_unique<Identifier>("x"),
+                                                                  std::make_unique<Constant>(2.0)),
+                                          std::make_unique<Power>(std::make_unique<Identifier>("y"),
+                                                                  std::make_unique<Constant>(2.0))),
+                    std::make_unique<Identifier>("r"));
+    Subtract diagonal(std::make_unique<Identifier>("x"), std::make_unique<Identifier>("y"));
+
+    NewtonSolver solver({&circle, &diagonal}, {"x", "y"});
+    std::vector<double> point{1.0, 0.5};
+    SolverResult result = solver.solve(point);
+    ASSERT_EQUAL(true, result.converged);
+    ASSERT_EQUAL(true, std::abs(point[0] - 2.0) < 1e-9 && std::abs(point[1] - 2.0) < 1e-9);
+}
+
+// Test solveBatch on independent systems solved in parallel
+void testSolveBatch() {
+    // k * 2^2 - c = 0 for several targets c, each solved for k.
+    std::vector<std::unique_ptr<const ASTNode>> equations;
+    std::vector<NewtonSolver> solvers;
+    std::vector<std::vector<double>> guesses;
+    for (int i = 1; i <= 8; ++i) {
+        equations.push_back(std::make_unique<Subtract>(
+            std::make_unique<Multiply>(std::make_unique<Identifier>("k"),
+                                       std::make_unique<Power>(std::make_unique<Constant>(2.0),
+                                                               std::make_unique<Constant>(2.0))),
+            std::make_unique<Constant>(4.0 * i)));
+        solvers.emplace_back(std::vector<const ASTNode *>{equations.back().get()}, std::vector<std::string>{"k"});
+        guesses.push_back({0.0});
+    }
+
+    std::vector<SolverResult> results;
+    solveBatch(solvers, guesses, results, SolverOptions(), 4);
+    bool allSolved = true;
+    for (int i = 1; i <= 8; ++i) {
+        allSolved = allSolved && results[i - 1].converged && std::abs(guesses[i - 1][0] - i) < 1e-9;
+    }
+    ASSERT_EQUAL(true, allSolved);
+}
+
+// Test simplify on identities that preserve IEEE semantics
+void testSimplifyIdentities() {
+    // (x * 1) + +(-(-y)) -> x + y
+    Identifier::setVariable("x", 3.0);
+    Identifier::setVariable("y", 4.0);
+    auto tree = simplify(std::make_unique<Add>(
+        std::make_unique<Multiply>(std::make_unique<Identifier>("x"), std::make_unique<Constant>(1.0)),
+        std::make_unique<UnaryPlus>(
+            std::make_unique<UnaryMinus>(std::make_unique<UnaryMinus>(std::make_unique<Identifier>("y"))))));
+    Add expected(std::make_unique<Identifier>("x"), std::make_unique<Identifier>("y"));
+    ASSERT_EQUAL(true, sameTree(expected, *tree));
+
+    // (2 + 3) * 4 -> 20
+    auto folded = simplify(std::make_unique<Multiply>(
+        std::make_unique<Add>(std::make_unique<Constant>(2.0), std::make_unique<Constant>(3.0)),
+        std::make_unique<Constant>(4.0)));
+    ASSERT_EQUAL(true, folded->getType() == ASTNode::Type::Constant);
+    ASSERT_EQUAL(20.0, folded->evaluate());
+}
+
+// Test that x - x and x + 0 are only rewritten when IEEE semantics are relaxed
+void testSimplifyRelaxed() {
+    auto makeTree = [] {
+        return std::make_unique<Add>(
+            std::make_unique<Subtract>(std::make_unique<Identifier>("x"), std::make_unique<Identifier>("x")),
+            std::make_unique<Constant>(0.0));
+    };
+    auto strict = simplify(makeTree());
+    ASSERT_EQUAL(true, strict->getType() == ASTNode::Type::Add);
+
+    SimplifyOptions relaxed;
+    relaxed.strictIEEE = false;
+    auto fast = simplify(makeTree(), relaxed);
+    ASSERT_EQUAL(true, fast->getType() == ASTNode::Type::Constant);
+    ASSERT_EQUAL(0.0, fast->evaluate());
+}
+
+// Test that the e-graph optimizer factors a*b + a*c into a*(b+c)
+void testEGraphFactoring() {
+    Identifier::setVariable("a", 2.0);
+    Identifier::setVariable("b", 3.0);
+    Identifier::setVariable("c", 5.0);
+    Add tree(std::make_unique<Multiply>(std::make_unique<Identifier>("a"), std::make_unique<Identifier>("b")),
+             std::make_unique<Multiply>(std::make_unique<Identifier>("a"), std::make_unique<Identifier>("c")));
+    auto optimized = optimize(tree);
+    ASSERT_EQUAL(true, optimized->getType() == ASTNode::Type::Multiply);
+    ASSERT_EQUAL(true, treeCost(*optimized) < treeCost(tree));
+    ASSERT_EQUAL(16.0, optimized->evaluate());
+}
+
+// Test that the e-graph optimizer replaces x^2 with x*x and respects its node budget
+void testEGraphBudget() {
+    Identifier::setVariable("x", 3.0);
+    Power square(std::make_unique<Identifier>("x"), std::make_unique<Constant>(2.0));
+    auto optimized = optimize(square);
+    ASSERT_EQUAL(true, optimized->getType() == ASTNode::Type::Multiply);
+
+    // A long sum explodes under associativity and commutativity; the budget keeps the result valid.
+    std::unique_ptr<const ASTNode> sum = std::make_unique<Identifier>("x");
+    for (int i = 1; i <= 24; ++i) {
+        sum = std::make_unique<Add>(std::move(sum), std::make_unique<Constant>(i));
+    }
+    EGraphOptions options;
+    options.maxNodes = 500;
+    auto bounded = optimize(*sum, options);
+    ASSERT_EQUAL(sum->evaluate(), bounded->evaluate());
+}
+
+// Test the multiply-add contraction pass
+void testContractMultiplyAdd() {
+    Identifier::setVariable("a", 3.0);
+    Identifier::setVariable("b", 4.0);
+    Identifier::setVariable("c", 5.0);
+    auto sum = contractMultiplyAdd(std::make_unique<Add>(
+        std::make_unique<Multiply>(std::make_unique<Identifier>("a"), std::make_unique<Identifier>("b")),
+        std::make_unique<Identifier>("c")));
+    ASSERT_EQUAL(true, sum->getType() == ASTNode::Type::MultiplyAdd);
+    ASSERT_EQUAL(17.0, sum->evaluate());
+
+    auto difference = contractMultiplyAdd(std::make_unique<Subtract>(
+        std::make_unique<Identifier>("c"),
+        std::make_unique<Multiply>(std::make_unique<Identifier>("a"), std::make_unique<Identifier>("b"))));
+    ASSERT_EQUAL(true, difference->getType() == ASTNode::Type::MultiplyAdd);
+    ASSERT_EQUAL(-7.0, difference->evaluate());
+}
+
+// Test BatchEvaluator against per-row evaluation, including a MultiplyAdd node
+void testBatchEvaluator() {
+    // fma(x, k, x / 2) with x bound to a column and k read from the variable table
+    Identifier::setVariable("k", 3.0);
+    MultiplyAdd tree(std::make_unique<Identifier>("x"), std::make_unique<Identifier>("k"),
+                     std::make_unique<Divide>(std::make_unique<Identifier>("x"), std::make_unique<Constant>(2.0)));
+
+    std::vector<double> column(1000), results(column.size());
+    for (std::size_t i = 0; i < column.size(); ++i) {
+        column[i] = 0.25 * i;
+    }
+    BatchEvaluator batch;
+    batch.bindColumn("x", column.data());
+    batch.evaluate(tree, results.data(), results.size());
+
+    bool matches = true;
+    for (std::size_t i = 0; i < column.size(); ++i) {
+        Identifier::setVariable("x", column[i]);
+        matches = matches && results[i] == tree.evaluate();
+    }
+    ASSERT_EQUAL(true, matches);
+}
+
+// Test polynomial detection and Horner evaluation, per row and in batch
+void testDetectPolynomials() {
+    // 3 * x^3 - x^2 + 2 * x + 1
+    auto cube = std::make_unique<Multiply>(
+        std::make_unique<Constant>(3.0),
+        std::make_unique<Power>(std::make_unique<Identifier>("x"), std::make_unique<Constant>(3.0)));
+    auto square = std::make_unique<Power>(std::make_unique<Identifier>("x"), std::make_unique<Constant>(2.0));
+    auto linear = std::make_unique<Multiply>(std::make_unique<Constant>(2.0), std::make_unique<Identifier>("x"));
+    auto tree = detectPolynomials(std::make_unique<Add>(
+        std::make_unique<Add>(std::make_unique<Subtract>(std::move(cube), std::move(square)), std::move(linear)),
+        std::make_unique<Constant>(1.0)));
+    ASSERT_EQUAL(true, tree->getType() == ASTNode::Type::Polynomial);
+    ASSERT_EQUAL(4u, static_cast<const Polynomial &>(*tree).getCoefficients().size());
+
+    Identifier::setVariable("x", 2.0);
+    ASSERT_EQUAL(25.0, tree->evaluate());
+
+    std::vector<double> column{-1.0, 0.0, 2.0}, results(3);
+    BatchEvaluator batch;
+    batch.bindColumn("x", column.data());
+    batch.evaluate(*tree, results.data(), results.size());
+    ASSERT_EQUAL(true, results == std::vector<double>({-5.0, 1.0, 25.0}));
+}
+
+// Test that reassociation balances a long sum without changing its (exactly representable) value
+void testReassociate() {
+    std::unique_ptr<const ASTNode> chain = std::make_unique<Constant>(0.0);
+    for (int i = 1; i <= 16; ++i) {
+        chain = std::make_unique<Add>(std::move(chain), std::make_unique<Constant>(i));
+    }
+    auto balanced = reassociate(std::move(chain));
+    ASSERT_EQUAL(136.0, balanced->evaluate());
+
+    // 17 operands give a tree of depth 6 instead of 17.
+    const ASTNode *node = balanced.get();
+    int depth = 1;
+    while (node->getType() == ASTNode::Type::Add) {
+        node = &static_cast<const Binary &>(*node).getRight();
+        ++depth;
+    }
+    ASSERT_EQUAL(true, depth <= 6);
+}
+
+// Test flattening of Add/Subtract and Multiply chains into Sum and Product nodes
+void testFlattenChains() {
+    // x0 + x1 - x2 + x3 - ... over 50 terms, left-deep
+    std::unique_ptr<const ASTNode> chain = std::make_unique<Identifier>("x");
+    for (int i = 1; i < 50; ++i) {
+        auto term = std::make_unique<Multiply>(std::make_unique<Constant>(0.1 * i), std::make_unique<Identifier>("x"));
+        if (i % 2) {
+            chain = std::make_unique<Add>(std::move(chain), std::move(term));
+        } else {
+            chain = std::make_unique<Subtract>(std::move(chain), std::move(term));
+        }
+    }
+    Identifier::setVariable("x", 1.7);
+    double expected = chain->evaluate();
+    auto flat = flattenChains(std::move(chain));
+    ASSERT_EQUAL(true, flat->getType() == ASTNode::Type::Sum);
+    ASSERT_EQUAL(50u, static_cast<const Sum &>(*flat).getOperandCount());
+    ASSERT_EQUAL(expected, flat->evaluate());
+
+    std::vector<double> column{1.7, -2.0}, results(2);
+    BatchEvaluator batch;
+    batch.bindColumn("x", column.data());
+    batch.evaluate(*flat, results.data(), results.size());
+    ASSERT_EQUAL(expected, results[0]);
+
+    // a * b * c -> Product
+    auto product = flattenChains(std::make_unique<Multiply>(
+        std::make_unique<Multiply>(std::make_unique<Constant>(2.0), std::make_unique<Identifier>("x")),
+        std::make_unique<Constant>(3.0)));
+    ASSERT_EQUAL(true, product->getType() == ASTNode::Type::Product);
+    ASSERT_EQUAL(2.0 * 1.7 * 3.0, product->evaluate());
+}
+
+// Test that BatchEvaluator hoists row-invariant subtrees and still matches per-row evaluation
+void testBatchHoisting() {
+    // (w^2 / 4) * f + (b - 1), with f bound to a column and w, b scalar parameters
+    Identifier::setVariable("w", 3.0);
+    Identifier::setVariable("b", 0.5);
+    Add tree(std::make_unique<Multiply>(
+                 std::make_unique<Divide>(std::make_unique<Power>(std::make_unique<Identifier>("w"),
+                                                                  std::make_unique<Constant>(2.0)),
+                                          std::make_unique<Constant>(4.0)),
+                 std::make_unique<Identifier>("f")),
+             std::make_unique<Subtract>(std::make_unique<Identifier>("b"), std::make_unique<Constant>(1.0)));
+
+    std::vector<double> features{1.0, 2.0, 4.0}, results(3);
+    BatchEvaluator batch;
+    batch.bindColumn("f", features.data());
+    batch.evaluate(tree, results.data(), results.size());
+    ASSERT_EQUAL(2u, batch.getHoistedCount());
+    ASSERT_EQUAL(true, results == std::vector<double>({1.75, 4.0, 8.5}));
+}
+
+// Test partial evaluation with some identifiers bound
+void testSpecialize() {
+    // a * x + Sum(b, b, 1) with a = 1, b = 2 -> x + 5
+    std::vector<std::unique_ptr<const ASTNode>> operands;
+    operands.push_back(std::make_unique<Identifier>("b"));
+    operands.push_back(std::make_unique<Identifier>("b"));
+    operands.push_back(std::make_unique<Constant>(1.0));
+    Add formula(std::make_unique<Multiply>(std::make_unique<Identifier>("a"), std::make_unique<Identifier>("x")),
+                std::make_unique<Sum>(std::move(operands)));
+
+    auto residual = specialize(formula, {{"a", 1.0}, {"b", 2.0}});
+    Add expected(std::make_unique<Identifier>("x"), std::make_unique<Constant>(5.0));
+    ASSERT_EQUAL(true, sameTree(*residual, expected));
+
+    // Re-specializing with new parameters leaves the original formula untouched.
+    Identifier::setVariable("x", 3.0);
+    ASSERT_EQUAL(7.0, specialize(formula, {{"a", 2.0}, {"b", 0.0}})->evaluate());
+    ASSERT_EQUAL(true, formula.getLeft().getType() == ASTNode::Type::Multiply);
+}
+
+// Test that snapshot reads never see half of a batched write, and that the directory and slots grow
+void testVariableStore() {
+    VariableStore store;
+    for (int i = 0; i < 2000; ++i) {
+        store.set("v" + std::to_string(i), i);
+    }
+    double value = 0.0;
+    ASSERT_EQUAL(true, store.get("v1999", value));
+    ASSERT_EQUAL(1999.0, value);
+    store.clear();
+    ASSERT_EQUAL(false, store.get("v7", value));
+
+    // The writer keeps x + y == 0; readers must never observe anything else.
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    store.set("x", 0.0);
+    store.set("y", 0.0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; ++t) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                double sum = store.read([&] {
+                    double x = 0.0, y = 0.0;
+                    store.get("x", x);
+                    store.get("y", y);
+                    return x + y;
+                });
+                torn += sum != 0.0;
+            }
+        });
+    }
+    for (int i = 1; i <= 20000; ++i) {
+        store.write([&](VariableStore::Writer &writer) {
+            writer.set("x", i);
+            writer.set("y", -i);
+        });
+    }
+    done = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL(0, torn.load());
+}
+
+// Test binding identifiers to caller memory: a double, a field of the current object and a strided column
+void testBindings() {
+    struct Quote {
+        double bid, ask;
+    };
+    double spot = 2.0;
+    Quote first{1.0, 2.0}, second{3.0, 5.0};
+    const void *current = &first;
+    Identifier::bindVariable("spot", &spot);
+    Identifier::getVariableStore().bindField("ask", &current, offsetof(Quote, ask));
+
+    Multiply tree(std::make_unique<Identifier>("spot"), std::make_unique<Identifier>("ask"));
+    ASSERT_EQUAL(4.0, tree.evaluate());
+    spot = 3.0;
+    current = &second;
+    ASSERT_EQUAL(15.0, tree.evaluate());
+    Identifier::setVariable("spot", 1.0); // Replaces the binding.
+    spot = 100.0;
+    ASSERT_EQUAL(5.0, tree.evaluate());
+    // Rebinding rewrites the variable's binding record in place, whatever kind of binding it held.
+    Identifier::getVariableStore().bindField("spot", &current, offsetof(Quote, bid));
+    ASSERT_EQUAL(15.0, tree.evaluate());
+    Identifier::bindVariable("spot", &spot);
+    ASSERT_EQUAL(500.0, tree.evaluate());
+
+    std::vector<Quote> quotes{{1.0, 2.0}, {3.0, 4.0}, {5.0, 6.0}};
+    std::vector<double> spreads(quotes.size());
+    Subtract spread(std::make_unique<Identifier>("ask"), std::make_unique<Identifier>("bid"));
+    BatchEvaluator batch;
+    batch.bindColumn("bid", &quotes[0].bid, sizeof(Quote));
+    batch.bindColumn("ask", &quotes[0].ask, sizeof(Quote));
+    batch.evaluate(spread, spreads.data(), spreads.size());
+    ASSERT_EQUAL(true, spreads == std::vector<double>({1.0, 1.0, 1.0}));
+    Identifier::clearVariables(); // Drop the binding to the local object.
+}
+
+// Test interned symbols and string_view names
+void testInternedSymbols() {
+    std::string_view line = "rate,spot";
+    Identifier spot(line.substr(5));
+    VariableStore::Symbol symbol = Identifier::intern("spot");
+    ASSERT_EQUAL(symbol, spot.getSymbol());
+    ASSERT_EQUAL(true, Identifier("rate").getSymbol() != symbol);
+
+    Identifier::setVariable(symbol, 2.5);
+    ASSERT_EQUAL(2.5, spot.evaluate());
+    Identifier::setVariable(line.substr(5), 3.0);
+    ASSERT_EQUAL(3.0, spot.evaluate());
+}
+
+// Test variable handles: direct reads and writes, stability across directory growth and bulk updates
+void testVariableHandles() {
+    VariableHandle spot = Identifier::registerVariable("spot");
+    VariableHandle rate = Identifier::registerVariable("rate");
+    Multiply tree(std::make_unique<Identifier>("spot"), std::make_unique<Identifier>("rate"));
+    spot.set(4.0);
+    rate.set(0.5);
+    ASSERT_EQUAL(2.0, tree.evaluate());
+
+    for (int i = 0; i < 500; ++i) {
+        Identifier::setVariable("filler" + std::to_string(i), i); // Grows the directory.
+    }
+    VariableHandle handles[] = {spot, rate};
+    double values[] = {10.0, 0.25};
+    Identifier::setVariables(handles, values, 2);
+    double value = 0.0;
+    ASSERT_EQUAL(true, spot.get(value));
+    ASSERT_EQUAL(10.0, value);
+    ASSERT_EQUAL(2.5, tree.evaluate());
+}
+
+// Test a shared-memory segment: a writer mapping and a reader mapping attached to the variable table
+void testSharedSegment() {
+    std::string name = "/ast-test-" + std::to_string(getpid());
+    SharedVariableSegment writer(name, 16);
+    writer.write([](SharedVariableSegment &segment) {
+        segment.setUnsequenced("bid", 99.0);
+        segment.setUnsequenced("ask", 101.0);
+    });
+
+    SharedVariableSegment reader(name);
+    SharedVariableSegment::unlink(name); // Both mappings stay valid.
+    double value = 0.0;
+    ASSERT_EQUAL(2u, reader.getCount());
+    ASSERT_EQUAL(true, reader.get("ask", value));
+    ASSERT_EQUAL(101.0, value);
+    ASSERT_EQUAL(false, reader.get("last", value));
+
+    reader.attach(Identifier::getVariableStore());
+    Subtract spread(std::make_unique<Identifier>("ask"), std::make_unique<Identifier>("bid"));
+    ASSERT_EQUAL(2.0, spread.evaluate());
+    writer.set("ask", 100.5);
+    ASSERT_EQUAL(1.5, spread.evaluate());
+
+    // Attaching again after the table was cleared restores the bindings.
+    Identifier::clearVariables();
+    reader.attach(Identifier::getVariableStore());
+    ASSERT_EQUAL(1.5, spread.evaluate());
+
+    // Creating the segment again leaves existing mappings untouched instead of zeroing them.
+    SharedVariableSegment replacement(name, 16);
+    SharedVariableSegment::unlink(name);
+    ASSERT_EQUAL(true, reader.get("ask", value));
+    ASSERT_EQUAL(100.5, value);
+    Identifier::clearVariables(); // Drop the bindings before the mappings go away.
+}
+
+// Test per-variable and table versions and change notifications
+void testVariableVersions() {
+    VariableStore store;
+    VariableStore::Symbol a = store.intern("a"), b = store.intern("b");
+    store.set(a, 1.0);
+    std::uint64_t version = store.getVersion();
+    store.set(b, 2.0);
+    ASSERT_EQUAL(version + 1, store.getVersion());
+    ASSERT_EQUAL(version, store.getVersion(a));
+    ASSERT_EQUAL(version + 1, store.getVersion(b));
+
+    std::vector<VariableStore::Symbol> seen;
+    int tableCalls = 0;
+    VariableStore::SubscriptionId id = store.subscribe(a, [&](VariableStore::Symbol symbol, std::uint64_t) {
+        seen.push_back(symbol);
+    });
+    store.subscribe([&](VariableStore::Symbol, std::uint64_t) { ++tableCalls; });
+    store.set(b, 3.0);
+    store.set(a, 4.0);
+    store.clear();
+    ASSERT_EQUAL(true, seen == std::vector<VariableStore::Symbol>({a, VariableStore::anySymbol}));
+    ASSERT_EQUAL(3, tableCalls);
+    ASSERT_EQUAL(store.getVersion(), store.getVersion(b)); // Cleared.
+
+    store.unsubscribe(id);
+    store.set(a, 5.0);
+    ASSERT_EQUAL(2u, seen.size());
+}
+
+// Test the result cache: hits, precise invalidation, uncached bound variables and CLOCK eviction
+void testResultCache() {
+    Identifier::setVariable("x", 1.0);
+    Identifier::setVariable("y", 2.0);
+    Add sum(std::make_unique<Identifier>("x"), std::make_unique<Identifier>("y"));
+    ResultCache cache(2, 1);
+    ASSERT_EQUAL(3.0, cache.evaluate(sum));
+    ASSERT_EQUAL(3.0, cache.evaluate(sum));
+    Identifier::setVariable("unrelated", 5.0);
+    ASSERT_EQUAL(3.0, cache.evaluate(sum));
+    Identifier::setVariable("x", 10.0);
+    ASSERT_EQUAL(12.0, cache.evaluate(sum));
+    CacheStats stats = cache.getStats();
+    ASSERT_EQUAL(2u, stats.hits);
+    ASSERT_EQUAL(2u, stats.misses);
+
+    double live = 1.0;
+    Identifier::bindVariable("live", &live);
+    Multiply bound(std::make_unique<Identifier>("live"), std::make_unique<Constant>(2.0));
+    ASSERT_EQUAL(2.0, cache.evaluate(bound));
+    live = 4.0;
+    ASSERT_EQUAL(8.0, cache.evaluate(bound));
+
+    Constant one(1.0), two(2.0);
+    cache.evaluate(one);
+    cache.evaluate(two);
+    stats = cache.getStats();
+    ASSERT_EQUAL(2u, stats.size);
+    ASSERT_EQUAL(1u, stats.evictions);
+    cache.forget(one);
+    ASSERT_EQUAL(1u, cache.getStats().size);
+    Identifier::setVariable("live", 0.0); // Drop the binding to the local.
+}
+
+// Test structural hashing, equality, canonical operand order and structure-keyed caching
+void testStructuralHash() {
+    auto build = [](const char *first, const char *second) -> std::unique_ptr<const ASTNode> {
+        return std::make_unique<Multiply>(
+            std::make_unique<Add>(std::make_unique<Identifier>(first), std::make_unique<Identifier>(second)),
+            std::make_unique<Constant>(2.0));
+    };
+    auto a = build("x", "y"), b = build("x", "y"), swapped = build("y", "x");
+    ASSERT_EQUAL(structuralHash(*a), structuralHash(*b));
+    ASSERT_EQUAL(true, structurallyEqual(*a, *b));
+    ASSERT_EQUAL(false, structurallyEqual(*a, *swapped));
+    ASSERT_EQUAL(true, structurallyEqual(*canonicalize(clone(*a)), *canonicalize(std::move(swapped))));
+
+    // Replacing an operand invalidates the cached hash.
+    std::uint64_t before = structuralHash(*b);
+    mutableBinary(b).resetRight(std::make_unique<Constant>(3.0));
+    ASSERT_EQUAL(true, structuralHash(*b) != before);
+
+    // Separately built copies share a cache entry.
+    Identifier::setVariable("x", 1.0);
+    Identifier::setVariable("y", 2.0);
+    ResultCache cache(16);
+    auto copy = build("x", "y");
+    ASSERT_EQUAL(6.0, cache.evaluate(*a));
+    ASSERT_EQUAL(6.0, cache.evaluate(*copy));
+    ASSERT_EQUAL(1u, cache.getStats().hits);
+
+    // Changing a subtree in place clears the cached hashes of its ancestors too, so the tree hashes like a
+    // freshly built equal tree and shares its cache entry.
+    ASSERT_EQUAL(6.0, cache.evaluate(*a));
+    const auto &inner = static_cast<const Binary &>(static_cast<const Binary &>(*a).getLeft());
+    const_cast<Binary &>(inner).resetRight(std::make_unique<Constant>(5.0));
+    auto fresh = parseExpression("(x + 5) * 2");
+    ASSERT_EQUAL(true, structurallyEqual(*a, *fresh));
+    ASSERT_EQUAL(12.0, cache.evaluate(*a));
+    ASSERT_EQUAL(12.0, cache.evaluate(*fresh));
+    ASSERT_EQUAL(3u, cache.getStats().hits);
+
+    // Releasing an operand of a Sum clears the hashes above it as well.
+    std::vector<std::unique_ptr<const ASTNode>> terms;
+    terms.push_back(std::make_unique<Identifier>("x"));
+    terms.push_back(std::make_unique<Constant>(1.0));
+    UnaryMinus negated(std::make_unique<Sum>(std::move(terms)));
+    std::uint64_t whole = structuralHash(negated);
+    auto &sum = const_cast<Sum &>(static_cast<const Sum &>(negated.getInput()));
+    std::unique_ptr<const ASTNode> one = sum.releaseOperand(1);
+    sum.resetOperand(1, std::make_unique<Constant>(2.0));
+    ASSERT_EQUAL(true, structuralHash(negated) != whole);
+    sum.resetOperand(1, std::move(one));
+    ASSERT_EQUAL(whole, structuralHash(negated));
+}
+
+// Test the expression parser: precedence, associativity, unary operators and errors
+void testParser() {
+    Identifier::setVariable("x", 3.0);
+    ASSERT_EQUAL(7.0, parseExpression("1 + 2 * x")->evaluate());
+    ASSERT_EQUAL(-9.0, parseExpression("-x^2")->evaluate());
+    ASSERT_EQUAL(512.0, parseExpression("2^3^2")->evaluate());
+    ASSERT_EQUAL(0.5, parseExpression("2 ^ -1")->evaluate());
+    ASSERT_EQUAL(2.0, parseExpression("(x - 1.5e0) / .75")->evaluate());
+    ASSERT_EQUAL(1.0, parseExpression("x - 1 - 1")->evaluate());
+
+    bool threw = false;
+    try {
+        parseExpression("1 + (2");
+    } catch (const std::invalid_argument &) {
+        threw = true;
+    }
+    ASSERT_EQUAL(true, threw);
+}
+
+// Test the program cache: hits, byte-bounded eviction and concurrent lookups
+void testProgramCache() {
+    Identifier::setVariable("x", 2.0);
+    ProgramCache cache(1 << 20);
+    ASSERT_EQUAL(5.0, cache.evaluate("x * x + 1"));
+    ASSERT_EQUAL(5.0, cache.evaluate("x * x + 1"));
+    CacheStats stats = cache.getStats();
+    ASSERT_EQUAL(1u, stats.hits);
+    ASSERT_EQUAL(1u, stats.misses);
+
+    // A budget of about one program keeps evicting.
+    ProgramCache small(400);
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_EQUAL(2.0 + i, small.evaluate("x + " + std::to_string(i)));
+    }
+    stats = small.getStats();
+    ASSERT_EQUAL(true, stats.evictions >= 6 && stats.bytes <= 400);
+
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 2000; ++i) {
+                int k = i % 16;
+                wrong += small.evaluate("x * " + std::to_string(k)) != 2.0 * k;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQUAL(0, wrong.load());
+}
+
+// Test the binary program image: in-place evaluation, tree round trip and rejection of corrupted files
+void testProgramImage() {
+    Identifier::setVariable("x", 2.0);
+    Identifier::setVariable("y", 3.0);
+    std::vector<std::unique_ptr<const ASTNode>> trees;
+    trees.push_back(parseExpression("(x + 1) * y - x / y + 2 ^ -x"));
+    trees.push_back(std::make_unique<Polynomial>(std::make_unique<Identifier>("x"), std::vector<double>{1, -2, 3}));
+    std::vector<std::unique_ptr<const ASTNode>> operands;
+    operands.push_back(std::make_unique<MultiplyAdd>(std::make_unique<Identifier>("x"),
+                                                     std::make_unique<Identifier>("y"), std::make_unique<Constant>(1)));
+    operands.push_back(std::make_unique<UnaryMinus>(std::make_unique<Identifier>("y")));
+    trees.push_back(std::make_unique<Sum>(std::move(operands)));
+
+    ProgramImageWriter writer;
+    for (const auto &tree : trees) {
+        writer.add(*tree);
+    }
+    const std::string path = "/tmp/ast_test_image." + std::to_string(getpid());
+    writer.write(path);
+    {
+        MappedProgramImage image(path);
+        ASSERT_EQUAL(trees.size(), image.size());
+        for (std::size_t i = 0; i < trees.size(); ++i) {
+            ASSERT_EQUAL(trees[i]->evaluate(), image.evaluate(i));
+            ASSERT_EQUAL(true, sameTree(*trees[i], *image.toTree(i)));
+        }
+    }
+    std::remove(path.c_str());
+
+    auto rejects = [](const std::vector<char> &bytes) {
+        try {
+            ProgramImage image(bytes.data(), bytes.size());
+        } catch (const std::runtime_error &) {
+            return true;
+        }
+        return false;
+    };
+    std::vector<char> bytes = writer.finish();
+    bytes[bytes.size() / 2] ^= 1;
+    ASSERT_EQUAL(true, rejects(bytes));
+
+    // The header is checksummed too: a program count that still passes the bounds checks is caught.
+    bytes = writer.finish();
+    --reinterpret_cast<image::Header *>(bytes.data())->programCount;
+    ASSERT_EQUAL(true, rejects(bytes));
+}
+
+// Test the on-disk program cache: reuse across instances, rejection of damaged entries, ProgramCache hookup
+void testDiskProgramCache() {
+    Identifier::setVariable("x", 2.0);
+    const std::string directory = "/tmp/ast_test_programs." + std::to_string(getpid());
+    const std::string text = "x * x + 1 * x";
+    {
+        DiskProgramCache disk(directory);
+        ASSERT_EQUAL(6.0, disk.load(text)->evaluate());
+        ASSERT_EQUAL(1u, disk.getStats().misses);
+    }
+    DiskProgramCache disk(directory);
+    ASSERT_EQUAL(6.0, disk.load(text)->evaluate());
+    ASSERT_EQUAL(1u, disk.getStats().hits);
+
+    // A damaged entry is recompiled and replaced.
+    std::FILE *file = std::fopen(disk.pathFor(text).c_str(), "r+b");
+    std::fseek(file, -4, SEEK_END);
+    std::fputc('!', file);
+    std::fclose(file);
+    ASSERT_EQUAL(6.0, disk.load(text)->evaluate());
+    ASSERT_EQUAL(1u, disk.getStats().misses);
+
+    ProgramCache programs(1 << 20, 64, disk.compiler());
+    ASSERT_EQUAL(6.0, programs.evaluate(text));
+    ASSERT_EQUAL(2u, disk.getStats().hits);
+
+    // A cache with another compiler tag in the same directory never reuses these trees.
+    DiskProgramCache raw(directory, "parse/1", [](std::string_view text) { return parseExpression(text); });
+    ASSERT_EQUAL(true, raw.pathFor(text) != disk.pathFor(text));
+    ASSERT_EQUAL(true, sameTree(*parseExpression(text), *raw.load(text)));
+    ASSERT_EQUAL(1u, raw.getStats().misses);
+
+    std::remove(disk.pathFor(text).c_str());
+    std::remove(raw.pathFor(text).c_str());
+    rmdir(directory.c_str());
+}
+
+// Test the CSV reader: chunked reads across 64-byte blocks, blank lines, CRLF, column selection and errors
+void testCsvReader() {
+    std::string text = "x, y ,z\n1,2,3\n\n4.5,-5,6\r\n";
+    for (int i = 0; i < 20; ++i) {
+        text += std::to_string(i) + ",1e-3," + std::string(10, ' ') + std::to_string(i) + "\n";
+    }
+    text += "7,,9"; // No final newline; the empty field reads as NaN.
+    CsvReader reader(text.data(), text.size());
+    ASSERT_EQUAL(std::string("y"), reader.getNames()[1]);
+    reader.selectColumns(*parseExpression("x + z"));
+    ASSERT_EQUAL(false, reader.isSelected(1));
+    ASSERT_EQUAL(2u, reader.read(2));
+    ASSERT_EQUAL(4.5, reader.column(0)[1]);
+    ASSERT_EQUAL(6.0, reader.column(2)[1]);
+    ASSERT_EQUAL(20u, reader.read(20));
+    ASSERT_EQUAL(19.0, reader.column(2)[19]);
+    ASSERT_EQUAL(1u, reader.read(100));
+    ASSERT_EQUAL(9.0, reader.column(2)[0]);
+    ASSERT_EQUAL(0u, reader.read(100));
+
+    const char block[] = "a,b\n1,2\n3,oops\n";
+    CsvReader bad(block, sizeof(block) - 1);
+    bool threw = false;
+    try {
+        bad.read(10);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    ASSERT_EQUAL(true, threw);
+
+    // An identifier that is neither a column nor a set variable is rejected by name.
+    requireColumns(*parseExpression("x * y"), reader.getNames());
+    std::string message;
+    try {
+        requireColumns(*parseExpression("x * csvScale"), reader.getNames());
+    } catch (const std::runtime_error &error) {
+        message = error.what();
+    }
+    ASSERT_EQUAL(true, message.find("'csvScale'") != std::string::npos);
+    Identifier::setVariable("csvScale", 2.0);
+    requireColumns(*parseExpression("x * csvScale"), reader.getNames());
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        std::size_t mismatches = 0;
+        for (std::size_t i = 0; i + 64 <= text.size(); ++i) {
+            mismatches += structuralMaskScalar(text.data() + i, ',') != structuralMaskAvx2(text.data() + i, ',');
+        }
+        ASSERT_EQUAL(0u, mismatches);
+    }
+#endif
+}
+
+// Test the columnar format: row groups, alignment, in-place evaluation and rejection of other files
+void testColumnarFile() {
+    const std::string path = "/tmp/ast_test_columns." + std::to_string(getpid()) + ".col";
+    std::vector<double> x = {1, 2, 3, 4, 5, 6, 7}, y = {7, 6, 5, 4, 3, 2, 1};
+    ColumnarWriter writer(path, {"x", "y"}, 3);
+    const double *columns[] = {x.data(), y.data()};
+    writer.append(columns, 2);
+    columns[0] += 2;
+    columns[1] += 2;
+    writer.append(columns, 5);
+    writer.close();
+
+    ColumnarFile file(path);
+    ASSERT_EQUAL(std::string("y"), file.getNames()[1]);
+    ASSERT_EQUAL(7u, file.getRowCount());
+    ASSERT_EQUAL(3u, file.getGroupCount());
+    ASSERT_EQUAL(1u, file.getGroupRows(2));
+    ASSERT_EQUAL(0u, reinterpret_cast<std::uintptr_t>(file.column(1, 1)) % 64);
+    auto tree = parseExpression("x * 10 + y");
+    BatchEvaluator evaluator;
+    std::vector<double> out(3);
+    evaluator.bindColumn("x", file.column(1, 0));
+    evaluator.bindColumn("y", file.column(1, 1));
+    evaluator.evaluate(*tree, out.data(), file.getGroupRows(1));
+    ASSERT_EQUAL(44.0, out[0]);
+    ASSERT_EQUAL(62.0, out[2]);
+    std::remove(path.c_str());
+
+    const char csv[] = "x,y\n1,2\n";
+    writeFileReplacing(path, csv, sizeof(csv) - 1);
+    bool threw = false;
+    try {
+        ColumnarFile other(path);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    ASSERT_EQUAL(true, threw);
+    std::remove(path.c_str());
+}
+
+// Test the result writer: shortest round-trip text, binary output and buffer refills
+void testResultWriter() {
+    const std::string path = "/tmp/ast_test_results." + std::to_string(getpid());
+    int descriptor = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    {
+        ResultWriter text(descriptor, ResultWriter::Format::Text, 40);
+        double values[] = {0.1, -2.0, 1e300, 3103.49};
+        text.write(values, 4);
+        text.write(2.0 / 3.0);
+    }
+    std::string expected = "0.1\n-2\n1e+300\n3103.49\n0.6666666666666666\n";
+    {
+        ResultWriter binary(descriptor, ResultWriter::Format::Binary, 40);
+        std::vector<double> values(10, 0.5);
+        binary.write(values.data(), values.size());
+        binary.flush();
+    }
+    FileMapping file(path);
+    ASSERT_EQUAL(expected, std::string(file.data(), expected.size()));
+    ASSERT_EQUAL(expected.size() + 80, file.size());
+    double last;
+    std::memcpy(&last, file.data() + file.size() - 8, 8);
+    ASSERT_EQUAL(0.5, last);
+    close(descriptor);
+    std::remove(path.c_str());
+}
+
+// Test the pipelined evaluator: input order across workers with tiny chunks, and error propagation
+void testPipeline() {
+    std::string text = "i,w\n";
+    for (int i = 0; i < 1000; ++i) {
+        text += std::to_string(i) + ",2\n";
+    }
+    CsvReader reader(text.data(), text.size());
+    auto tree = parseExpression("i * w");
+    std::vector<double> results;
+    auto collect = [&](const double *values, std::size_t rows) {
+        results.insert(results.end(), values, values + rows);
+    };
+    evaluatePipelined(reader, *tree, collect, 3, 7);
+    std::size_t wrong = 0;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        wrong += results[i] != 2.0 * i;
+    }
+    ASSERT_EQUAL(1000u, results.size());
+    ASSERT_EQUAL(0u, wrong);
+
+    // A failing sink stops the pipeline and its exception reaches the caller.
+    CsvReader again(text.data(), text.size());
+    bool threw = false;
+    try {
+        auto fail = [](const double *, std::size_t) { throw std::runtime_error("disk full"); };
+        evaluatePipelined(again, *tree, fail, 2, 7);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    ASSERT_EQUAL(true, threw);
+
+    // The sink fails while the reader is inside its fourth read, with every chunk in flight: once that read
+    // returns the reader finds the pipeline stopped and ends, so exactly four reads happen.
+    struct GatedReader {
+        CsvReader reader;
+        std::atomic<std::size_t> reads{0};
+        std::atomic<bool> waiting{false}, released{false};
+        const std::vector<std::string> &getNames() const { return reader.getNames(); }
+        bool isSelected(std::size_t i) const { return reader.isSelected(i); }
+        std::size_t read(std::size_t maxRows, double *const *targets) {
+            if (++reads == 4) {
+                waiting.store(true);
+                while (!released.load()) {
+                    std::this_thread::yield();
+                }
+            }
+            return reader.read(maxRows, targets);
+        }
+    } gated{CsvReader(text.data(), text.size())};
+    threw = false;
+    try {
+        auto fail = [&](const double *, std::size_t) {
+            while (!gated.waiting.load()) {
+                std::this_thread::yield();
+            }
+            gated.released.store(true);
+            throw std::runtime_error("disk full");
+        };
+        evaluatePipelined(gated, *tree, fail, 1, 7);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    ASSERT_EQUAL(true, threw);
+    ASSERT_EQUAL(4u, gated.reads.load());
+
+    // A worker that throws stops the pipeline as well, and its exception reaches the caller.
+    struct FailingReader {
+        CsvReader reader;
+        std::atomic<std::size_t> reads{0};
+        const std::vector<std::string> &getNames() const { return reader.getNames(); }
+        bool isSelected(std::size_t i) const {
+            if (reads.load() != 0) {
+                throw std::length_error("column lost");
+            }
+            return reader.isSelected(i);
+        }
+        std::size_t read(std::size_t maxRows, double *const *targets) {
+            ++reads;
+            return reader.read(maxRows, targets);
+        }
+    } failing{CsvReader(text.data(), text.size())};
+    threw = false;
+    std::size_t sunk = 0;
+    try {
+        evaluatePipelined(failing, *tree, [&](const double *, std::size_t) { ++sunk; }, 2, 7);
+    } catch (const std::length_error &) {
+        threw = true;
+    }
+    ASSERT_EQUAL(true, threw);
+    ASSERT_EQUAL(0u, sunk);
+}
+
+// Test block input: lines split across small blocks, read with io_uring and with pread, match the mapped reader
+void testBlockReader() {
+    const std::string path = "/tmp/ast_test_blocks." + std::to_string(getpid()) + ".csv";
+    std::string text = "a,b\n";
+    for (int i = 0; i < 3000; ++i) {
+        text += std::to_string(i) + "," + std::to_string(i * 0.125) + (i % 7 == 0 ? "\n\n" : "\n");
+    }
+    text += "3000,375"; // No final newline.
+    writeFileReplacing(path, text.data(), text.size());
+
+    CsvReader mapped(path);
+    std::vector<double> expected;
+    for (std::size_t rows; (rows = mapped.read(100)) > 0;) {
+        expected.insert(expected.end(), mapped.column(1), mapped.column(1) + rows);
+    }
+    for (bool useRing : {true, false}) {
+        BlockCsvReader reader(path, 4096, 3, useRing);
+        ASSERT_EQUAL(std::string("b"), reader.getNames()[1]);
+        std::vector<double> values;
+        for (std::size_t rows; (rows = reader.read(100)) > 0;) {
+            values.insert(values.end(), reader.column(1), reader.column(1) + rows);
+        }
+        ASSERT_EQUAL(3001u, values.size());
+        ASSERT_EQUAL(true, values == expected);
+    }
+
+    // A line longer than a block is carried across several blocks.
+    std::string wide = "w\n" + std::string(10000, ' ') + "42\n";
+    writeFileReplacing(path, wide.data(), wide.size());
+    BlockCsvReader reader(path, 4096);
+    ASSERT_EQUAL(1u, reader.read(10));
+    ASSERT_EQUAL(42.0, reader.column(0)[0]);
+    ASSERT_EQUAL(0u, reader.read(10));
+
+    // Block sizes are rounded up to whole pages, with either kind of read.
+    for (bool useRing : {true, false}) {
+        BlockReader blocks(path, 5000, 2, useRing);
+        ASSERT_EQUAL(8192u, blocks.next().size());
+        ASSERT_EQUAL(wide.size() - 8192, blocks.next().size());
+        ASSERT_EQUAL(0u, blocks.next().size());
+    }
+    std::remove(path.c_str());
+}
+
 int runTests() {
     // Run the tests
     testConstant();
@@ -106,6 +1056,36 @@ int runTests() {
     testDivide();
     testPower();
     testIdentifierUndefinedVariable();
+    testNewtonSolver();
+    testSolveBatch();
+    testSimplifyIdentities();
+    testSimplifyRelaxed();
+    testEGraphFactoring();
+    testEGraphBudget();
+    testContractMultiplyAdd();
+    testBatchEvaluator();
+    testDetectPolynomials();
+    testReassociate();
+    testFlattenChains();
+    testBatchHoisting();
+    testSpecialize();
+    testVariableStore();
+    testBindings();
+    testInternedSymbols();
+    testVariableHandles();
+    testSharedSegment();
+    testVariableVersions();
+    testResultCache();
+    testStructuralHash();
+    testParser();
+    testProgramCache();
+    testProgramImage();
+    testDiskProgramCache();
+    testCsvReader();
+    testColumnarFile();
+    testResultWriter();
+    testPipeline();
+    testBlockReader();
 
     std::cout << "All tests passed successfully.\n";
 
@@ -114,14 +1094,608 @@ int runTests() {
 
 #endif // ENABLE_TESTS
 
+// Conditional compilation based on ENABLE_BENCHMARKS macro.
+#ifdef ENABLE_BENCHMARKS
+#include <chrono>
+#include <fstream>
+
+// Runs body the given number of times and prints the average time per iteration.
+template <typename Body> void benchmark(const char *name, std::size_t iterations, Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        body();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Benchmark: " << name << " ... " << elapsed.count() / iterations << " ns/iteration.\n";
+}
+
+// Builds a left-deep sum of the identifiers x0 ... x(terms - 1).
+std::unique_ptr<const ASTNode> makeLeftDeepSum(int terms) {
+    std::unique_ptr<const ASTNode> sum = std::make_unique<Identifier>("x0");
+    for (int i = 1; i < terms; ++i) {
+        sum = std::make_unique<Add>(std::move(sum), std::make_unique<Identifier>("x" + std::to_string(i)));
+    }
+    return sum;
+}
+
+// Benchmark left-deep, reassociated and flattened sums in the tree and batch evaluation paths
+void benchmarkReassociation() {
+    const int terms = 64;
+    const std::size_t rows = 4096;
+    std::vector<std::vector<double>> columns(terms, std::vector<double>(rows));
+    for (int i = 0; i < terms; ++i) {
+        Identifier::setVariable("x" + std::to_string(i), i * 0.5);
+        for (std::size_t row = 0; row < rows; ++row) {
+            columns[i][row] = i + row * 1e-3;
+        }
+    }
+
+    auto leftDeep = makeLeftDeepSum(terms);
+    auto balanced = reassociate(makeLeftDeepSum(terms));
+    volatile double sink = 0.0;
+    benchmark("tree, left-deep sum of 64", 100000, [&] { sink = leftDeep->evaluate(); });
+    benchmark("tree, balanced sum of 64", 100000, [&] { sink = balanced->evaluate(); });
+
+    BatchEvaluator batch;
+    for (int i = 0; i < terms; ++i) {
+        batch.bindColumn("x" + std::to_string(i), columns[i].data());
+    }
+    std::vector<double> out(rows);
+    benchmark("batch, left-deep sum of 64 x 4096 rows", 200, [&] { batch.evaluate(*leftDeep, out.data(), rows); });
+    benchmark("batch, balanced sum of 64 x 4096 rows", 200, [&] { batch.evaluate(*balanced, out.data(), rows); });
+
+    auto flat = flattenChains(makeLeftDeepSum(terms));
+    benchmark("tree, Sum node of 64", 100000, [&] { sink = flat->evaluate(); });
+    benchmark("batch, Sum node of 64 x 4096 rows", 200, [&] { batch.evaluate(*flat, out.data(), rows); });
+    (void)sink;
+}
+
+// Benchmark batch evaluation of "coefficients x features" with and without invariant hoisting
+void benchmarkHoisting() {
+    const int terms = 16;
+    const std::size_t rows = 4096;
+    std::vector<std::vector<double>> features(terms, std::vector<double>(rows, 1.5));
+    BatchEvaluator batch;
+    std::unique_ptr<const ASTNode> model = std::make_unique<Constant>(0.0);
+    for (int i = 0; i < terms; ++i) {
+        std::string index = std::to_string(i);
+        Identifier::setVariable("w" + index, 0.1 * i);
+        batch.bindColumn("f" + index, features[i].data());
+        // (w_i ^ 2 / 3) * f_i
+        auto coefficient = std::make_unique<Divide>(
+            std::make_unique<Power>(std::make_unique<Identifier>("w" + index), std::make_unique<Constant>(2.0)),
+            std::make_unique<Constant>(3.0));
+        model = std::make_unique<Add>(std::move(model), std::make_unique<Multiply>(
+                                                            std::move(coefficient),
+                                                            std::make_unique<Identifier>("f" + index)));
+    }
+
+    std::vector<double> out(rows);
+    batch.setHoisting(false);
+    benchmark("batch, 16 coefficients x features, no hoisting", 200, [&] { batch.evaluate(*model, out.data(), rows); });
+    batch.setHoisting(true);
+    benchmark("batch, 16 coefficients x features, hoisted", 200, [&] { batch.evaluate(*model, out.data(), rows); });
+}
+
+// Benchmark variable reads under a concurrent writer: the lock-free store against a mutex-guarded map
+void benchmarkVariableContention() {
+    const std::size_t reads = 1000000;
+    Add tree(std::make_unique<Identifier>("p"), std::make_unique<Identifier>("q"));
+    std::mutex mutex;
+    std::unordered_map<std::string, double> locked{{"p", 1.0}, {"q", 2.0}};
+    Identifier::setVariable("p", 1.0);
+    Identifier::setVariable("q", 2.0);
+
+    // Runs body reads times on each of threadCount threads while one thread keeps writing p and q, and
+    // reports wall time per read over all threads.
+    auto contended = [&](const std::string &name, unsigned threadCount, auto body, auto write) {
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            for (double value = 0.0; !done.load(std::memory_order_relaxed); value += 1.0) {
+                write(value);
+                std::this_thread::yield();
+            }
+        });
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> readers;
+        for (unsigned t = 0; t < threadCount; ++t) {
+            readers.emplace_back([&] {
+                double sink = 0.0;
+                for (std::size_t i = 0; i < reads; ++i) {
+                    sink += body();
+                }
+                volatile double keep = sink;
+                (void)keep;
+            });
+        }
+        for (auto &reader : readers) {
+            reader.join();
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        done = true;
+        writer.join();
+        std::cout << "Benchmark: " << name << ", " << threadCount << " readers ... "
+                  << elapsed.count() / (reads * threadCount) << " ns/read.\n";
+    };
+
+    for (unsigned threads : {1u, 4u, 8u}) {
+        contended(
+            "mutex + unordered_map", threads,
+            [&] {
+                std::lock_guard<std::mutex> lock(mutex);
+                return locked.at("p") + locked.at("q");
+            },
+            [&](double value) {
+                std::lock_guard<std::mutex> lock(mutex);
+                locked["p"] = value;
+                locked["q"] = -value;
+            });
+        contended(
+            "VariableStore snapshot", threads,
+            [&] { return Identifier::getVariableStore().read([&] { return tree.evaluate(); }); },
+            [&](double value) {
+                Identifier::getVariableStore().write([&](VariableStore::Writer &writer) {
+                    writer.set("p", value);
+                    writer.set("q", -value);
+                });
+            });
+    }
+}
+
+// Benchmark variable updates and reads by name against interned symbols
+void benchmarkSymbols() {
+    const std::size_t iterations = 1000000;
+    VariableStore::Symbol symbol = Identifier::intern("spot");
+    Identifier spot("spot");
+    VariableStore &store = Identifier::getVariableStore();
+    double value = 0.0;
+    benchmark("setVariable by name", iterations, [&] { Identifier::setVariable("spot", value += 1.0); });
+    benchmark("setVariable by symbol", iterations, [&] { Identifier::setVariable(symbol, value += 1.0); });
+    VariableHandle handle = Identifier::registerVariable("spot");
+    benchmark("set by handle", iterations, [&] { handle.set(value += 1.0); });
+    std::vector<VariableHandle> handles;
+    std::vector<double> values(16, 1.0);
+    for (int i = 0; i < 16; ++i) {
+        handles.push_back(Identifier::registerVariable("tick" + std::to_string(i)));
+    }
+    benchmark("setVariables, 16 handles", iterations / 16, [&] {
+        Identifier::setVariables(handles.data(), values.data(), values.size());
+    });
+    benchmark("get by name", iterations, [&] { store.get("spot", value); });
+    benchmark("get by handle", iterations, [&] { handle.get(value); });
+    benchmark("Identifier::evaluate (symbol)", iterations, [&] { value += spot.evaluate(); });
+    std::cout << "(checksum " << value << ")\n";
+}
+
+// Benchmark repeated evaluation of a 64-term sum with and without the result cache
+void benchmarkResultCache() {
+    auto sum = makeLeftDeepSum(64);
+    ResultCache cache(1024);
+    volatile double sink = 0.0;
+    benchmark("tree, 64 terms, uncached", 100000, [&] { sink = sink + sum->evaluate(); });
+    benchmark("tree, 64 terms, cached, inputs unchanged", 100000, [&] { sink = sink + cache.evaluate(*sum); });
+    Identifier::setVariable("unrelated", 0.0);
+    benchmark("tree, 64 terms, cached, unrelated variable written", 100000, [&] {
+        Identifier::setVariable("unrelated", sink);
+        sink = sink + cache.evaluate(*sum);
+    });
+}
+
+// Benchmark parsing and simplifying a formula on every request against the program cache
+void benchmarkProgramCache() {
+    const std::string formula = "(x0 + x1 * 2 - x2 / 4) ^ 2 + 3 * x3 * x3 - (x4 - 1) * (x5 + 1)";
+    ProgramCache cache(1 << 20);
+    volatile double sink = 0.0;
+    benchmark("parse + simplify + evaluate", 100000, [&] {
+        sink = sink + simplify(parseExpression(formula))->evaluate();
+    });
+    benchmark("program cache + evaluate", 100000, [&] { sink = sink + cache.evaluate(formula); });
+}
+
+// Benchmark startup: parsing formulas from text against mapping a prebuilt program image
+void benchmarkProgramImage() {
+    std::vector<std::string> formulas;
+    ProgramImageWriter writer;
+    for (int i = 0; i < 1000; ++i) {
+        std::string k = std::to_string(i);
+        formulas.push_back("(x0 + x1 * " + k + " - x2 / 4) ^ 2 + 3 * x3 * x3 - (x4 - " + k + ") * (x5 + 1)");
+        writer.add(*parseExpression(formulas.back()));
+    }
+    const std::string path = "/tmp/ast_bench_image." + std::to_string(getpid());
+    writer.write(path);
+    volatile double sink = 0.0;
+    benchmark("load 1000 formulas: parse text", 20, [&] {
+        for (const std::string &formula : formulas) {
+            sink = sink + parseExpression(formula)->evaluate();
+        }
+    });
+    benchmark("load 1000 formulas: map image", 20, [&] {
+        MappedProgramImage image(path);
+        for (std::size_t i = 0; i < image.size(); ++i) {
+            sink = sink + image.evaluate(i);
+        }
+    });
+    auto tree = parseExpression(formulas[0]);
+    MappedProgramImage image(path);
+    benchmark("evaluate tree", 100000, [&] { sink = sink + tree->evaluate(); });
+    benchmark("evaluate image in place", 100000, [&] { sink = sink + image.evaluate(0); });
+    std::remove(path.c_str());
+}
+
+// Benchmark a cold start that parses and optimizes every formula against a warm start from the disk cache
+void benchmarkDiskProgramCache() {
+    std::vector<std::string> formulas;
+    for (int i = 0; i < 200; ++i) {
+        std::string k = std::to_string(i);
+        formulas.push_back("(x0 + x1 * " + k + " - x2 / 4) ^ 2 + 3 * x3 * x3 - (x4 - " + k + ") * (x5 + 1) * 1");
+    }
+    auto compile = [](std::string_view text) { return optimize(*simplify(parseExpression(text))); };
+    const std::string directory = "/tmp/ast_bench_programs." + std::to_string(getpid());
+    DiskProgramCache disk(directory, "parse+simplify+optimize/1", compile);
+    volatile double sink = 0.0;
+    benchmark("start 200 formulas: parse + simplify", 20, [&] {
+        for (const std::string &formula : formulas) {
+            sink = sink + simplify(parseExpression(formula))->evaluate();
+        }
+    });
+    benchmark("start 200 formulas: parse + simplify + e-graph", 5, [&] {
+        for (const std::string &formula : formulas) {
+            sink = sink + compile(formula)->evaluate();
+        }
+    });
+    for (const std::string &formula : formulas) {
+        disk.load(formula);
+    }
+    benchmark("start 200 formulas: disk cache", 20, [&] {
+        for (const std::string &formula : formulas) {
+            sink = sink + disk.load(formula)->evaluate();
+        }
+    });
+    for (const std::string &formula : formulas) {
+        std::remove(disk.pathFor(formula).c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+// Benchmark CSV scanning and parsing of 1M rows from memory, and the structural mask kernels alone
+void benchmarkCsvReader() {
+    std::string text = "price,qty,fee\n";
+    for (int i = 0; i < 1000000; ++i) {
+        text += std::to_string(i % 1000) + "." + std::to_string(i % 97) + "," + std::to_string(i % 50) + ",0.25\n";
+    }
+    std::cout << "(" << text.size() / 1000000 << " MB of CSV)\n";
+    volatile double sink = 0.0;
+    benchmark("CSV, 1M rows, 3 columns parsed", 5, [&] {
+        CsvReader reader(text.data(), text.size());
+        for (std::size_t rows; (rows = reader.read(1 << 16)) > 0;) {
+            sink = sink + reader.column(0)[rows - 1];
+        }
+    });
+    benchmark("CSV, 1M rows, 1 column parsed", 5, [&] {
+        CsvReader reader(text.data(), text.size());
+        reader.selectColumns(Identifier("qty"));
+        for (std::size_t rows; (rows = reader.read(1 << 16)) > 0;) {
+            sink = sink + reader.column(1)[rows - 1];
+        }
+    });
+    std::uint64_t bits = 0;
+    std::size_t blocks = text.size() / 64;
+    benchmark("structural mask, scalar, whole text", 5, [&] {
+        for (std::size_t i = 0; i < blocks; ++i) {
+            bits += structuralMaskScalar(text.data() + 64 * i, ',');
+        }
+    });
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        benchmark("structural mask, AVX2, whole text", 5, [&] {
+            for (std::size_t i = 0; i < blocks; ++i) {
+                bits += structuralMaskAvx2(text.data() + 64 * i, ',');
+            }
+        });
+    }
+#endif
+    std::cout << "(checksum " << bits + sink << ")\n";
+}
+
+// Benchmark evaluating over 1M rows read from CSV text against a mapped columnar file
+void benchmarkColumnarFile() {
+    const std::string csvPath = "/tmp/ast_bench_columns." + std::to_string(getpid()) + ".csv";
+    const std::string columnarPath = "/tmp/ast_bench_columns." + std::to_string(getpid()) + ".col";
+    std::string text = "price,qty,fee\n";
+    for (int i = 0; i < 1000000; ++i) {
+        text += std::to_string(i % 1000) + "." + std::to_string(i % 97) + "," + std::to_string(i % 50) + ",0.25\n";
+    }
+    writeFileReplacing(csvPath, text.data(), text.size());
+    {
+        CsvReader reader(csvPath);
+        ColumnarWriter writer(columnarPath, reader.getNames());
+        for (std::size_t rows; (rows = reader.read(1 << 16)) > 0;) {
+            const double *columns[] = {reader.column(0), reader.column(1), reader.column(2)};
+            writer.append(columns, rows);
+        }
+        writer.close();
+    }
+    auto tree = parseExpression("price * qty + fee");
+    std::vector<double> out(1 << 16);
+    volatile double sink = 0.0;
+    benchmark("evaluate 1M rows from CSV", 5, [&] {
+        CsvReader reader(csvPath);
+        BatchEvaluator evaluator;
+        for (std::size_t rows; (rows = reader.read(out.size())) > 0;) {
+            for (std::size_t c = 0; c < 3; ++c) {
+                evaluator.bindColumn(reader.getNames()[c], reader.column(c));
+            }
+            evaluator.evaluate(*tree, out.data(), rows);
+            sink = sink + out[0];
+        }
+    });
+    benchmark("evaluate 1M rows from columnar file", 5, [&] {
+        ColumnarFile file(columnarPath);
+        BatchEvaluator evaluator;
+        for (std::size_t g = 0; g < file.getGroupCount(); ++g) {
+            for (std::size_t c = 0; c < 3; ++c) {
+                evaluator.bindColumn(file.getNames()[c], file.column(g, c));
+            }
+            evaluator.evaluate(*tree, out.data(), file.getGroupRows(g));
+            sink = sink + out[0];
+        }
+    });
+    std::remove(csvPath.c_str());
+    std::remove(columnarPath.c_str());
+}
+
+// Benchmark formatting 1M results to /dev/null with iostreams against the buffered result writer
+void benchmarkResultWriter() {
+    std::vector<double> values(1000000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = std::sqrt(static_cast<double>(i)) * 1.37;
+    }
+    int descriptor = open("/dev/null", O_WRONLY);
+    std::ofstream stream("/dev/null");
+    stream.precision(17);
+    benchmark("1M results, std::ofstream << double", 3, [&] {
+        for (double value : values) {
+            stream << value << '\n';
+        }
+    });
+    benchmark("1M results, ResultWriter text", 3, [&] {
+        ResultWriter out(descriptor);
+        out.write(values.data(), values.size());
+    });
+    benchmark("1M results, ResultWriter binary", 3, [&] {
+        ResultWriter out(descriptor, ResultWriter::Format::Binary);
+        out.write(values.data(), values.size());
+    });
+    close(descriptor);
+}
+
+// Benchmark evaluating 1M CSV rows serially against the reader / workers / writer pipeline
+void benchmarkPipeline() {
+    std::string text = "price,qty,fee\n";
+    for (int i = 0; i < 1000000; ++i) {
+        text += std::to_string(i % 1000) + "." + std::to_string(i % 97) + "," + std::to_string(i % 50) + ",0.25\n";
+    }
+    auto tree = parseExpression("(price * qty + fee) ^ 0.5 / (1 + qty)");
+    int descriptor = open("/dev/null", O_WRONLY);
+    std::cout << "(" << std::thread::hardware_concurrency() << " hardware threads)\n";
+    benchmark("1M CSV rows, serial parse / evaluate / write", 3, [&] {
+        CsvReader reader(text.data(), text.size());
+        reader.selectColumns(*tree);
+        BatchEvaluator evaluator;
+        ResultWriter out(descriptor);
+        std::vector<double> results(1 << 16);
+        for (std::size_t rows; (rows = reader.read(results.size())) > 0;) {
+            for (std::size_t c = 0; c < 3; ++c) {
+                evaluator.bindColumn(reader.getNames()[c], reader.column(c));
+            }
+            evaluator.evaluate(*tree, results.data(), rows);
+            out.write(results.data(), rows);
+        }
+    });
+    for (std::size_t workers : {1, 2, 4}) {
+        std::string name = "1M CSV rows, pipelined, " + std::to_string(workers) + " workers";
+        benchmark(name.c_str(), 3, [&] {
+            CsvReader reader(text.data(), text.size());
+            reader.selectColumns(*tree);
+            ResultWriter out(descriptor);
+            evaluatePipelined(
+                reader, *tree, [&](const double *values, std::size_t rows) { out.write(values, rows); }, workers);
+        });
+    }
+    close(descriptor);
+}
+
+// Benchmark reading a CSV file evicted from the page cache: mapped, with io_uring read-ahead, and with pread
+void benchmarkBlockReader() {
+    const std::string path = "/tmp/ast_bench_blocks." + std::to_string(getpid()) + ".csv";
+    {
+        std::ofstream file(path);
+        file << "price,qty,fee\n";
+        for (int i = 0; i < 10000000; ++i) {
+            file << i % 1000 << '.' << i % 97 << ',' << i % 50 << ",0.25\n";
+        }
+    }
+    // Drops the file from the page cache, so every run reads it from the device.
+    auto evict = [&] {
+        int descriptor = open(path.c_str(), O_RDONLY);
+        fdatasync(descriptor);
+        posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+        close(descriptor);
+    };
+    volatile double sink = 0.0;
+    auto consume = [&](auto &reader) {
+        for (std::size_t rows; (rows = reader.read(1 << 16)) > 0;) {
+            sink = sink + reader.column(0)[rows - 1];
+        }
+    };
+    std::cout << "(" << BlockReader(path).size() / 1000000 << " MB of CSV, evicted before each run)\n";
+    benchmark("10M CSV rows, mmap", 3, [&] {
+        evict();
+        CsvReader reader(path);
+        consume(reader);
+    });
+    benchmark("10M CSV rows, io_uring, 4 x 1 MiB in flight", 3, [&] {
+        evict();
+        BlockCsvReader reader(path);
+        consume(reader);
+    });
+    benchmark("10M CSV rows, pread", 3, [&] {
+        evict();
+        BlockCsvReader reader(path, 1 << 20, 4, false);
+        consume(reader);
+    });
+    std::cout << "(io_uring " << (BlockReader(path).usesRing() ? "available" : "unavailable") << ", checksum " << sink
+              << ")\n";
+    std::remove(path.c_str());
+}
+
+int runBenchmarks() {
+    benchmarkReassociation();
+    benchmarkHoisting();
+    benchmarkVariableContention();
+    benchmarkSymbols();
+    benchmarkResultCache();
+    benchmarkProgramCache();
+    benchmarkProgramImage();
+    benchmarkDiskProgramCache();
+    benchmarkCsvReader();
+    benchmarkColumnarFile();
+    benchmarkResultWriter();
+    benchmarkPipeline();
+    benchmarkBlockReader();
+    return 0;
+}
+
+#endif // ENABLE_BENCHMARKS
+
+// Returns true if path ends with suffix.
+bool hasSuffix(const std::string &path, const std::string &suffix) {
+    return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Evaluates expression once or, given an input file, once per row with the columns bound to the identifiers of
+// the same name. Inputs ending in .col are columnar files evaluated in place; others are read as CSV or TSV.
+// Results go to standard output in the given format, or to output as a columnar file with one column named
+// "result". With workers > 0, CSV input is parsed, evaluated by that many threads and written in a pipeline.
+// CSV input is mapped when io is "mmap", or read in blocks with io_uring ("uring") or pread ("pread").
+int runEvaluation(const std::string &expression, const std::string &input, const std::string &output,
+                  ResultWriter::Format format, std::size_t workers, const std::string &io) {
+    constexpr std::size_t rowsPerChunk = 1 << 16;
+    try {
+        auto tree = simplify(parseExpression(expression));
+        ResultWriter out(STDOUT_FILENO, format);
+        if (input.empty()) {
+            out.write(tree->evaluate());
+            out.flush();
+            return 0;
+        }
+        std::unique_ptr<ColumnarWriter> writer;
+        if (!output.empty()) {
+            writer = std::make_unique<ColumnarWriter>(output, std::vector<std::string>{"result"});
+        }
+        BatchEvaluator evaluator;
+        std::vector<double> results(rowsPerChunk);
+        auto writeResults = [&](const double *values, std::size_t rows) {
+            if (writer) {
+                writer->append(&values, rows);
+            } else {
+                out.write(values, rows);
+            }
+        };
+        auto evaluateChunk = [&](std::size_t rows) {
+            results.resize(std::max(results.size(), rows));
+            evaluator.evaluate(*tree, results.data(), rows);
+            writeResults(results.data(), rows);
+        };
+        if (hasSuffix(input, ".col")) {
+            ColumnarFile file(input);
+            requireColumns(*tree, file.getNames());
+            for (std::size_t g = 0; g < file.getGroupCount(); ++g) {
+                for (std::size_t c = 0; c < file.getNames().size(); ++c) {
+                    evaluator.bindColumn(file.getNames()[c], file.column(g, c));
+                }
+                evaluateChunk(file.getGroupRows(g));
+            }
+        } else {
+            // Parses, evaluates and writes CSV input, pipelined across threads if workers were requested.
+            auto evaluateCsv = [&](auto &reader) {
+                reader.selectColumns(*tree);
+                requireColumns(*tree, reader.getNames());
+                if (workers > 0) {
+                    evaluatePipelined(reader, *tree, writeResults, workers, rowsPerChunk);
+                    return;
+                }
+                for (std::size_t rows; (rows = reader.read(rowsPerChunk)) > 0;) {
+                    for (std::size_t c = 0; c < reader.getNames().size(); ++c) {
+                        if (reader.isSelected(c)) {
+                            evaluator.bindColumn(reader.getNames()[c], reader.column(c));
+                        }
+                    }
+                    evaluateChunk(rows);
+                }
+            };
+            if (io == "mmap") {
+                CsvReader reader(input);
+                evaluateCsv(reader);
+            } else {
+                BlockCsvReader reader(input, 1 << 20, 4, io == "uring");
+                evaluateCsv(reader);
+            }
+        }
+        if (writer) {
+            writer->close();
+        }
+        out.flush();
+    } catch (const std::exception &error) {
+        std::cerr << "Error: " << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Converts a CSV or TSV file into a columnar file with the same column names.
+int convertToColumnar(const std::string &input, const std::string &output) {
+    try {
+        CsvReader reader(input);
+        ColumnarWriter writer(output, reader.getNames());
+        std::vector<const double *> columns(reader.getNames().size());
+        for (std::size_t rows; (rows = reader.read(1 << 16)) > 0;) {
+            for (std::size_t c = 0; c < columns.size(); ++c) {
+                columns[c] = reader.column(c);
+            }
+            writer.append(columns.data(), rows);
+        }
+        writer.close();
+    } catch (const std::exception &error) {
+        std::cerr << "Error: " << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
 // Function to print the help message.
 void printHelpMessage(const char *programName) {
-    std::cout << "Usage: " << programName << " [--run-tests]\n"
+    std::cout << "Usage: " << programName
+              << " [--run-tests | --run-benchmarks | --convert IN OUT |\n"
+              << "         --eval EXPR [--input FILE] [--output FILE] [--format F] [--workers N] [--io M]]\n"
               << "Options:\n"
               << "  --run-tests  Run the test for the expression evaluation code.\n"
               << "              This option should be used without any additional "
                  "arguments.\n"
-              << "              Example: " << programName << " --run-tests\n";
+              << "              Example: " << programName << " --run-tests\n"
+              << "  --run-benchmarks  Run the benchmarks (build with `make bench`).\n"
+              << "  --eval EXPR  Evaluate EXPR and print the result.\n"
+              << "  --input FILE  With --eval, evaluate EXPR for every row of a columnar (.col) file, or of a\n"
+              << "              CSV (or .tsv) file whose header line names the columns, printing one result per row.\n"
+              << "              Example: " << programName << " --eval \"price * qty\" --input orders.csv\n"
+              << "  --output FILE  With --input, write the results to a columnar file instead.\n"
+              << "  --format F  Print results as text (default, shortest round-trip form) or as binary\n"
+              << "              (raw 8-byte doubles).\n"
+              << "  --workers N  Stream CSV input through a pipeline: one thread parses, N threads\n"
+              << "              evaluate and the main thread writes, with results kept in input order.\n"
+              << "  --io M  Read CSV input by mmap (default), uring (io_uring with reads in flight, falling\n"
+              << "              back to pread where unavailable) or pread.\n"
+              << "  --convert IN OUT  Convert the CSV (or .tsv) file IN into the columnar file OUT.\n";
 }
 
 // Main function
@@ -132,6 +1706,39 @@ int main(int argc, char *argv[]) {
         // Run the test if ENABLE_TESTS is defined
         runTests();
 #endif // ENABLE_TESTS
+    } else if (argc == 2 && std::strcmp(argv[1], "--run-benchmarks") == 0) {
+#ifdef ENABLE_BENCHMARKS
+        // Run the benchmarks if ENABLE_BENCHMARKS is defined
+        runBenchmarks();
+#endif // ENABLE_BENCHMARKS
+    } else if (argc == 4 && std::strcmp(argv[1], "--convert") == 0) {
+        return convertToColumnar(argv[2], argv[3]);
+    } else if (argc >= 3 && argc % 2 == 1 && std::strcmp(argv[1], "--eval") == 0) {
+        std::string input, output;
+        ResultWriter::Format format = ResultWriter::Format::Text;
+        std::size_t workers = 0;
+        std::string io = "mmap";
+        for (int i = 3; i + 1 < argc; i += 2) {
+            if (std::strcmp(argv[i], "--input") == 0) {
+                input = argv[i + 1];
+            } else if (std::strcmp(argv[i], "--output") == 0) {
+                output = argv[i + 1];
+            } else if (std::strcmp(argv[i], "--format") == 0 && std::strcmp(argv[i + 1], "text") == 0) {
+                format = ResultWriter::Format::Text;
+            } else if (std::strcmp(argv[i], "--format") == 0 && std::strcmp(argv[i + 1], "binary") == 0) {
+                format = ResultWriter::Format::Binary;
+            } else if (std::strcmp(argv[i], "--workers") == 0 && std::atoi(argv[i + 1]) > 0) {
+                workers = static_cast<std::size_t>(std::atoi(argv[i + 1]));
+            } else if (std::strcmp(argv[i], "--io") == 0 &&
+                       (std::strcmp(argv[i + 1], "mmap") == 0 || std::strcmp(argv[i + 1], "uring") == 0 ||
+                        std::strcmp(argv[i + 1], "pread") == 0)) {
+                io = argv[i + 1];
+            } else {
+                printHelpMessage(argv[0]);
+                return 1;
+            }
+        }
+        return runEvaluation(argv[2], input, output, format, workers, io);
     } else {
         // Print help message if no valid arguments are provided
         printHelpMessage(argv[0]);
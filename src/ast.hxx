@@ -1,9 +1,16 @@
+#pragma once
+
 // Include necessary C++ standard library headers.
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <unordered_map>
+#include <vector>
+
+#include "variables.hxx"
 
 // Conditional compilation based on ENABLE_TESTS macro.
 #ifdef ENABLE_TESTS
@@ -25,13 +32,60 @@ class ASTNode {
         Subtract,   // Represents a subtraction operation.
         Multiply,   // Represents a multiplication operation.
         Divide,     // Represents a division operation.
-        Power       // Represents a power/exponentiation operation.
+        Power,      // Represents a power/exponentiation operation.
+        MultiplyAdd, // Represents a fused multiply-add operation.
+        Polynomial,  // Represents a polynomial in a single operand.
+        Nary,        // Represents an operation over any number of operands.
+        Sum,         // Represents the sum of all operands.
+        Product      // Represents the product of all operands.
     };
 
     // Virtual functions for evaluation and type retrieval.
     virtual double evaluate() const = 0;
     virtual ASTNode::Type getType() const = 0;
     virtual ~ASTNode() = default;
+
+    // Copies (of leaves such as Constant) start without a cached hash.
+    ASTNode() = default;
+    ASTNode(const ASTNode &) {}
+    ASTNode &operator=(const ASTNode &) {
+        invalidateHash();
+        return *this;
+    }
+
+    // Getter and setter for the cached structural hash (see hash.hxx); zero means not computed yet.
+    std::uint64_t getCachedHash() const { return cachedHash.load(std::memory_order_relaxed); }
+    void setCachedHash(std::uint64_t hash) const { cachedHash.store(hash, std::memory_order_relaxed); }
+
+  protected:
+    // Function to forget the cached hash of this node and of every ancestor, whose hashes include it. Called
+    // whenever an operand is replaced or released.
+    void invalidateHash() {
+        for (const ASTNode *node = this; node != nullptr; node = node->parent) {
+            node->cachedHash.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Function to record this node as the parent of a new operand.
+    void adopt(const std::unique_ptr<const ASTNode> &operand) const {
+        if (operand) {
+            operand->parent = this;
+        }
+    }
+
+    // Function to detach an operand that is released from this node.
+    static std::unique_ptr<const ASTNode> orphan(std::unique_ptr<const ASTNode> operand) {
+        if (operand) {
+            operand->parent = nullptr;
+        }
+        return operand;
+    }
+
+  private:
+    // Racing threads compute the same value, so a relaxed atomic is enough.
+    mutable std::atomic<std::uint64_t> cachedHash{0};
+    // The node owning this one as an operand, if any. Copies start without one.
+    mutable const ASTNode *parent = nullptr;
 };
 
 // Constant Node class
@@ -57,30 +111,57 @@ class Constant : public ASTNode {
 class Identifier : public ASTNode {
   private:
     std::string identifier;
-    static std::unordered_map<std::string, double> variableTable;
+    VariableStore::Symbol symbol;
+    static VariableStore variableTable;
 
   public:
     // Constructor for Identifier node.
-    explicit Identifier(const std::string &id) : identifier(id) {}
+    explicit Identifier(std::string_view id) : identifier(id), symbol(variableTable.intern(id)) {}
 
     // Implementation of getType for Identifier node.
     ASTNode::Type getType() const override { return ASTNode::Type::Identifier; }
 
+    // Getter function for the identifier name.
+    const std::string &getIdentifier() const { return identifier; }
+
+    // Getter function for the interned symbol of the identifier.
+    VariableStore::Symbol getSymbol() const { return symbol; }
+
     // Implementation of evaluate for Identifier node.
     double evaluate() const override {
-        try {
-            return variableTable.at(identifier);
-        } catch (const std::out_of_range) {
-            std::cerr << "Error: Undefined variable '" << identifier << ".'\n";
-            return 0.0;
+        double value;
+        if (variableTable.get(symbol, value)) {
+            return value;
         }
+        std::cerr << "Error: Undefined variable '" << identifier << ".'\n";
+        return 0.0;
     }
 
     // Static function to set a variable in the variableTable.
-    static void setVariable(const std::string &id, double value) { variableTable[id] = value; }
+    static void setVariable(std::string_view id, double value) { variableTable.set(id, value); }
+
+    // Static function to set a variable by its interned symbol, without hashing the name.
+    static void setVariable(VariableStore::Symbol symbol, double value) { variableTable.set(symbol, value); }
+
+    // Static function returning a handle for fast, hash-free reads and writes of one variable.
+    static VariableStore::Handle registerVariable(std::string_view id) { return variableTable.registerVariable(id); }
+
+    // Static function to set count variables, handles[i] to values[i], as one update.
+    static void setVariables(const VariableStore::Handle *handles, const double *values, std::size_t count) {
+        variableTable.set(handles, values, count);
+    }
+
+    // Static function to intern a name, for use with the symbol overloads.
+    static VariableStore::Symbol intern(std::string_view id) { return variableTable.intern(id); }
+
+    // Static function to bind a variable to caller-owned memory, which is read on every evaluation.
+    static void bindVariable(std::string_view id, const double *value) { variableTable.bind(id, value); }
 
     // Static function to clear all variables in the variableTable.
     static void clearVariables() { variableTable.clear(); }
+
+    // Static function giving access to the variable store, for snapshot reads and batched writes.
+    static VariableStore &getVariableStore() { return variableTable; }
 };
 
 // Unary Node base class
@@ -90,16 +171,30 @@ class Unary : public ASTNode {
 
   public:
     // Constructor for Unary node.
-    explicit Unary(std::unique_ptr<const ASTNode> operand) : operand(std::move(operand)) {}
+    explicit Unary(std::unique_ptr<const ASTNode> operand) : operand(std::move(operand)) { adopt(this->operand); }
+
+    // Operands point back at their parent, so operation nodes are neither copied nor moved.
+    Unary(const Unary &) = delete;
+    Unary &operator=(const Unary &) = delete;
 
     // Implementation of getType for Unary node.
     ASTNode::Type getType() const = 0;
 
     // Getter function to access the operand.
-    const ASTNode &getInput() { return *operand; }
+    const ASTNode &getInput() const { return *operand; }
 
     // Function to release ownership of the operand.
-    std::unique_ptr<const ASTNode> releaseInput() { return std::move(operand); }
+    std::unique_ptr<const ASTNode> releaseInput() {
+        invalidateHash();
+        return orphan(std::move(operand));
+    }
+
+    // Function to replace the operand.
+    void resetInput(std::unique_ptr<const ASTNode> input) {
+        operand = std::move(input);
+        adopt(operand);
+        invalidateHash();
+    }
 
     // Virtual destructor for Unary node.
     virtual ~Unary() = default;
@@ -138,15 +233,40 @@ class Binary : public ASTNode {
   public:
     // Constructor for Binary node.
     Binary(std::unique_ptr<const ASTNode> left, std::unique_ptr<const ASTNode> right)
-        : left(std::move(left)), right(std::move(right)) {}
+        : left(std::move(left)), right(std::move(right)) {
+        adopt(this->left);
+        adopt(this->right);
+    }
+
+    // Operands point back at their parent, so operation nodes are neither copied nor moved.
+    Binary(const Binary &) = delete;
+    Binary &operator=(const Binary &) = delete;
 
     // Getter functions to access left and right operands.
-    const ASTNode &getLeft() { return *left; }
-    const ASTNode &getRight() { return *right; }
+    const ASTNode &getLeft() const { return *left; }
+    const ASTNode &getRight() const { return *right; }
 
     // Functions to release ownership of left and right operands.
-    std::unique_ptr<const ASTNode> releaseLeft() { return std::move(left); }
-    std::unique_ptr<const ASTNode> releaseRight() { return std::move(right); }
+    std::unique_ptr<const ASTNode> releaseLeft() {
+        invalidateHash();
+        return orphan(std::move(left));
+    }
+    std::unique_ptr<const ASTNode> releaseRight() {
+        invalidateHash();
+        return orphan(std::move(right));
+    }
+
+    // Functions to replace left and right operands.
+    void resetLeft(std::unique_ptr<const ASTNode> operand) {
+        left = std::move(operand);
+        adopt(left);
+        invalidateHash();
+    }
+    void resetRight(std::unique_ptr<const ASTNode> operand) {
+        right = std::move(operand);
+        adopt(right);
+        invalidateHash();
+    }
 
     // Implementation of getType for Binary node.
     ASTNode::Type getType() const override { return ASTNode::Type::Binary; }
@@ -220,3 +340,196 @@ class Power : public Binary {
     // Implementation of evaluate for Power node.
     double evaluate() const override { return std::pow(left->evaluate(), right->evaluate()); }
 };
+
+// MultiplyAdd Node class
+//
+// Computes multiplicand * multiplier + addend with a single rounding. Only created by the opt-in contraction
+// pass, since the result can differ in the last bit from the separate Multiply and Add it replaces.
+class MultiplyAdd : public ASTNode {
+  private:
+    std::unique_ptr<const ASTNode> multiplicand;
+    std::unique_ptr<const ASTNode> multiplier;
+    std::unique_ptr<const ASTNode> addend;
+
+  public:
+    // Constructor for MultiplyAdd node.
+    MultiplyAdd(std::unique_ptr<const ASTNode> multiplicand, std::unique_ptr<const ASTNode> multiplier,
+                std::unique_ptr<const ASTNode> addend)
+        : multiplicand(std::move(multiplicand)), multiplier(std::move(multiplier)), addend(std::move(addend)) {
+        adopt(this->multiplicand);
+        adopt(this->multiplier);
+        adopt(this->addend);
+    }
+
+    // Operands point back at their parent, so operation nodes are neither copied nor moved.
+    MultiplyAdd(const MultiplyAdd &) = delete;
+    MultiplyAdd &operator=(const MultiplyAdd &) = delete;
+
+    // Getter functions to access the operands.
+    const ASTNode &getMultiplicand() const { return *multiplicand; }
+    const ASTNode &getMultiplier() const { return *multiplier; }
+    const ASTNode &getAddend() const { return *addend; }
+
+    // Functions to release ownership of the operands.
+    std::unique_ptr<const ASTNode> releaseMultiplicand() {
+        invalidateHash();
+        return orphan(std::move(multiplicand));
+    }
+    std::unique_ptr<const ASTNode> releaseMultiplier() {
+        invalidateHash();
+        return orphan(std::move(multiplier));
+    }
+    std::unique_ptr<const ASTNode> releaseAddend() {
+        invalidateHash();
+        return orphan(std::move(addend));
+    }
+
+    // Functions to replace the operands.
+    void resetMultiplicand(std::unique_ptr<const ASTNode> operand) {
+        multiplicand = std::move(operand);
+        adopt(multiplicand);
+        invalidateHash();
+    }
+    void resetMultiplier(std::unique_ptr<const ASTNode> operand) {
+        multiplier = std::move(operand);
+        adopt(multiplier);
+        invalidateHash();
+    }
+    void resetAddend(std::unique_ptr<const ASTNode> operand) {
+        addend = std::move(operand);
+        adopt(addend);
+        invalidateHash();
+    }
+
+    // Implementation of getType for MultiplyAdd node.
+    ASTNode::Type getType() const override { return ASTNode::Type::MultiplyAdd; }
+
+    // Implementation of evaluate for MultiplyAdd node.
+    double evaluate() const override {
+        return std::fma(multiplicand->evaluate(), multiplier->evaluate(), addend->evaluate());
+    }
+};
+
+// Polynomial Node class
+//
+// Evaluates coefficients[0] + coefficients[1] * x + ... + coefficients[n] * x^n in Horner form, one
+// std::fma per degree, where x is the operand.
+class Polynomial : public Unary {
+  private:
+    std::vector<double> coefficients;
+
+  public:
+    // Constructor for Polynomial node. Coefficients are ordered from the constant term upwards.
+    Polynomial(std::unique_ptr<const ASTNode> operand, std::vector<double> coefficients)
+        : Unary(std::move(operand)), coefficients(std::move(coefficients)) {}
+
+    // Getter function for the coefficients.
+    const std::vector<double> &getCoefficients() const { return coefficients; }
+
+    // Implementation of getType for Polynomial node.
+    ASTNode::Type getType() const override { return ASTNode::Type::Polynomial; }
+
+    // Implementation of evaluate for Polynomial node.
+    double evaluate() const override {
+        if (coefficients.empty()) {
+            return 0.0;
+        }
+        double x = operand->evaluate();
+        double result = coefficients.back();
+        for (std::size_t k = coefficients.size() - 1; k-- > 0;) {
+            result = std::fma(result, x, coefficients[k]);
+        }
+        return result;
+    }
+};
+
+// Nary Node base class
+class Nary : public ASTNode {
+  protected:
+    std::vector<std::unique_ptr<const ASTNode>> operands;
+
+  public:
+    // Constructor for Nary node.
+    explicit Nary(std::vector<std::unique_ptr<const ASTNode>> operands) : operands(std::move(operands)) {
+        for (const auto &operand : this->operands) {
+            adopt(operand);
+        }
+    }
+
+    // Operands point back at their parent, so operation nodes are neither copied nor moved.
+    Nary(const Nary &) = delete;
+    Nary &operator=(const Nary &) = delete;
+
+    // Getter functions to access the operands.
+    std::size_t getOperandCount() const { return operands.size(); }
+    const ASTNode &getOperand(std::size_t index) const { return *operands[index]; }
+
+    // Functions to release ownership of one or all operands.
+    std::unique_ptr<const ASTNode> releaseOperand(std::size_t index) {
+        invalidateHash();
+        return orphan(std::move(operands[index]));
+    }
+    std::vector<std::unique_ptr<const ASTNode>> releaseOperands() {
+        invalidateHash();
+        for (auto &operand : operands) {
+            operand = orphan(std::move(operand));
+        }
+        return std::move(operands);
+    }
+
+    // Function to replace one operand.
+    void resetOperand(std::size_t index, std::unique_ptr<const ASTNode> operand) {
+        operands[index] = std::move(operand);
+        adopt(operands[index]);
+        invalidateHash();
+    }
+
+    // Implementation of getType for Nary node.
+    ASTNode::Type getType() const = 0;
+
+    // Virtual destructor for Nary node.
+    virtual ~Nary() = default;
+};
+
+// Sum Node class
+class Sum : public Nary {
+  public:
+    using Nary::Nary;
+
+    // Implementation of getType for Sum node.
+    ASTNode::Type getType() const override { return ASTNode::Type::Sum; }
+
+    // Implementation of evaluate for Sum node. Operands are added left to right, matching the left-deep chain
+    // of Add nodes the Sum replaces.
+    double evaluate() const override {
+        double result = 0.0;
+        if (!operands.empty()) {
+            result = operands[0]->evaluate();
+        }
+        for (std::size_t i = 1; i < operands.size(); ++i) {
+            result += operands[i]->evaluate();
+        }
+        return result;
+    }
+};
+
+// Product Node class
+class Product : public Nary {
+  public:
+    using Nary::Nary;
+
+    // Implementation of getType for Product node.
+    ASTNode::Type getType() const override { return ASTNode::Type::Product; }
+
+    // Implementation of evaluate for Product node. Operands are multiplied left to right.
+    double evaluate() const override {
+        double result = 1.0;
+        if (!operands.empty()) {
+            result = operands[0]->evaluate();
+        }
+        for (std::size_t i = 1; i < operands.size(); ++i) {
+            result *= operands[i]->evaluate();
+        }
+        return result;
+    }
+};
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "transform.hxx"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+// Elementwise kernels used by the batch evaluator. The fused multiply-add kernel is cloned for CPUs with FMA
+// so that std::fma becomes a vector instruction instead of a library call.
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target_clones("fma", "default")))
+#endif
+inline void multiplyAddKernel(const double *a, const double *b, const double *c, double *out, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        out[i] = std::fma(a[i], b[i], c[i]);
+    }
+}
+
+// Evaluates a polynomial in Horner form for every row, vectorized across rows.
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target_clones("fma", "default")))
+#endif
+inline void hornerKernel(const std::vector<double> &coefficients, const double *x, double *out, std::size_t count) {
+    if (coefficients.empty()) {
+        std::fill(out, out + count, 0.0);
+        return;
+    }
+    std::fill(out, out + count, coefficients.back());
+    for (std::size_t k = coefficients.size() - 1; k-- > 0;) {
+        double c = coefficients[k];
+        for (std::size_t i = 0; i < count; ++i) {
+            out[i] = std::fma(out[i], x[i], c);
+        }
+    }
+}
+
+// Evaluates one expression over many rows.
+//
+// Identifiers bound with bindColumn() read one value per row; all other identifiers come from the variable
+// table. Rows are processed in blocks of blockSize, each node producing a whole block at a time, so the
+// per-node loops are simple enough for the compiler to vectorize and the tree is walked once per block rather
+// than once per row.
+//
+// Subtrees that read no bound column are row-invariant. Each evaluate() call computes every maximal invariant
+// subtree once, broadcasts it into a block buffer, and the per-block walk then reads that buffer as if it were
+// a constant column, so "coefficients * features" formulas only do the feature work per row.
+class BatchEvaluator {
+  public:
+    static constexpr std::size_t blockSize = 256;
+
+  private:
+    // A bound column: row i is the double at base + i * stride bytes.
+    struct Column {
+        const char *base;
+        std::size_t stride;
+    };
+
+    std::unordered_map<VariableStore::Symbol, Column> columns; // Keyed by interned symbol, not by name.
+    std::vector<std::vector<double>> scratch; // Two block buffers per tree depth, reused across calls.
+    std::unordered_map<const ASTNode *, std::size_t> hoisted; // Invariant subtree -> broadcast buffer index.
+    std::vector<std::vector<double>> broadcasts;              // Broadcast buffers, reused across calls.
+    bool hoisting = true;
+
+    // Evaluates an invariant subtree once and records its broadcast block.
+    void hoist(const ASTNode &node) {
+        std::size_t index = hoisted.size();
+        if (broadcasts.size() <= index) {
+            broadcasts.emplace_back(blockSize);
+        }
+        std::fill(broadcasts[index].begin(), broadcasts[index].end(), node.evaluate());
+        hoisted.emplace(&node, index);
+    }
+
+    // Returns true if node reads a bound column. Maximal invariant operands of varying nodes are hoisted.
+    bool classify(const ASTNode &node) {
+        if (node.getType() == ASTNode::Type::Identifier) {
+            return columns.count(static_cast<const Identifier &>(node).getSymbol()) > 0;
+        }
+        bool varying = false;
+        std::vector<const ASTNode *> invariant;
+        forEachChild(node, [&](const ASTNode &child) {
+            if (classify(child)) {
+                varying = true;
+            } else {
+                invariant.push_back(&child);
+            }
+        });
+        if (varying) {
+            for (const ASTNode *child : invariant) {
+                hoist(*child);
+            }
+        }
+        return varying;
+    }
+
+    // Depth of a tree.
+    static std::size_t depthOf(const ASTNode &node) {
+        std::size_t depth = 0;
+        forEachChild(node, [&](const ASTNode &child) { depth = std::max(depth, depthOf(child)); });
+        return depth + 1;
+    }
+
+    // Evaluates rows [begin, begin + count) of node. The result is written to out, or, for a bound column,
+    // the column itself is returned without copying.
+    const double *evaluateBlock(const ASTNode &node, std::size_t begin, std::size_t count, double *out,
+                                std::size_t depth) {
+        auto invariant = hoisted.find(&node);
+        if (invariant != hoisted.end()) {
+            return broadcasts[invariant->second].data();
+        }
+        double *first = scratch[2 * depth].data(), *second = scratch[2 * depth + 1].data();
+        switch (node.getType()) {
+        case ASTNode::Type::Constant:
+            std::fill(out, out + count, static_cast<const Constant &>(node).getValue());
+            return out;
+        case ASTNode::Type::Identifier: {
+            auto it = columns.find(static_cast<const Identifier &>(node).getSymbol());
+            if (it != columns.end()) {
+                const Column &column = it->second;
+                const char *first = column.base + begin * column.stride;
+                if (column.stride == sizeof(double)) {
+                    return reinterpret_cast<const double *>(first);
+                }
+                for (std::size_t i = 0; i < count; ++i) {
+                    std::memcpy(out + i, first + i * column.stride, sizeof(double));
+                }
+                return out;
+            }
+            std::fill(out, out + count, node.evaluate());
+            return out;
+        }
+        case ASTNode::Type::UnaryPlus:
+            return evaluateBlock(static_cast<const Unary &>(node).getInput(), begin, count, out, depth + 1);
+        case ASTNode::Type::UnaryMinus: {
+            const double *x = evaluateBlock(static_cast<const Unary &>(node).getInput(), begin, count, out, depth + 1);
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = -x[i];
+            }
+            return out;
+        }
+        case ASTNode::Type::Polynomial: {
+            const auto &polynomial = static_cast<const Polynomial &>(node);
+            const double *x = evaluateBlock(polynomial.getInput(), begin, count, first, depth + 1);
+            hornerKernel(polynomial.getCoefficients(), x, out, count);
+            return out;
+        }
+        case ASTNode::Type::Sum:
+        case ASTNode::Type::Product: {
+            // Accumulate one operand block at a time; leaf operands bound to columns are read in place.
+            const auto &nary = static_cast<const Nary &>(node);
+            bool sum = node.getType() == ASTNode::Type::Sum;
+            if (nary.getOperandCount() == 0) {
+                std::fill(out, out + count, sum ? 0.0 : 1.0);
+                return out;
+            }
+            const double *x = evaluateBlock(nary.getOperand(0), begin, count, out, depth + 1);
+            if (x != out) {
+                std::copy(x, x + count, out);
+            }
+            for (std::size_t k = 1; k < nary.getOperandCount(); ++k) {
+                x = evaluateBlock(nary.getOperand(k), begin, count, first, depth + 1);
+                if (sum) {
+                    for (std::size_t i = 0; i < count; ++i) {
+                        out[i] += x[i];
+                    }
+                } else {
+                    for (std::size_t i = 0; i < count; ++i) {
+                        out[i] *= x[i];
+                    }
+                }
+            }
+            return out;
+        }
+        case ASTNode::Type::MultiplyAdd: {
+            const auto &fma = static_cast<const MultiplyAdd &>(node);
+            const double *a = evaluateBlock(fma.getMultiplicand(), begin, count, out, depth + 1);
+            const double *b = evaluateBlock(fma.getMultiplier(), begin, count, first, depth + 1);
+            const double *c = evaluateBlock(fma.getAddend(), begin, count, second, depth + 1);
+            multiplyAddKernel(a, b, c, out, count);
+            return out;
+        }
+        case ASTNode::Type::Add:
+        case ASTNode::Type::Subtract:
+        case ASTNode::Type::Multiply:
+        case ASTNode::Type::Divide:
+        case ASTNode::Type::Power:
+            break;
+        default:
+            throw std::invalid_argument("BatchEvaluator: unsupported node type");
+        }
+
+        const auto &binary = static_cast<const Binary &>(node);
+        const double *l = evaluateBlock(binary.getLeft(), begin, count, out, depth + 1);
+        const double *r = evaluateBlock(binary.getRight(), begin, count, first, depth + 1);
+        switch (node.getType()) {
+        case ASTNode::Type::Add:
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = l[i] + r[i];
+            }
+            break;
+        case ASTNode::Type::Subtract:
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = l[i] - r[i];
+            }
+            break;
+        case ASTNode::Type::Multiply:
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = l[i] * r[i];
+            }
+            break;
+        case ASTNode::Type::Divide:
+            // Same result as Divide::evaluate, without the per-row error report.
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = r[i] == 0 ? INFINITY : l[i] / r[i];
+            }
+            break;
+        default: // Power
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = std::pow(l[i], r[i]);
+            }
+            break;
+        }
+        return out;
+    }
+
+  public:
+    // Binds an identifier to a caller-owned column holding one value per row. A stride other than
+    // sizeof(double) reads a field of an array of structs in place, e.g. bindColumn("bid", &quotes[0].bid,
+    // sizeof(Quote)); contiguous columns are read without copying.
+    void bindColumn(std::string_view id, const double *column, std::size_t strideBytes = sizeof(double)) {
+        columns[Identifier::intern(id)] = Column{reinterpret_cast<const char *>(column), strideBytes};
+    }
+
+    // Enables or disables hoisting of row-invariant subtrees (enabled by default).
+    void setHoisting(bool enabled) { hoisting = enabled; }
+
+    // Number of invariant subtrees hoisted out of the per-row work by the last evaluate() call.
+    std::size_t getHoistedCount() const { return hoisted.size(); }
+
+    // Removes all column bindings.
+    void clearColumns() { columns.clear(); }
+
+    // Evaluates node for rows [0, rows) and stores the results in out.
+    void evaluate(const ASTNode &node, double *out, std::size_t rows) {
+        std::size_t buffers = 2 * (depthOf(node) + 1);
+        if (scratch.size() < buffers) {
+            scratch.resize(buffers, std::vector<double>(blockSize));
+        }
+        hoisted.clear();
+        if (hoisting && !classify(node)) {
+            hoist(node);
+        }
+        for (std::size_t begin = 0; begin < rows; begin += blockSize) {
+            std::size_t count = std::min(blockSize, rows - begin);
+            const double *result = evaluateBlock(node, begin, count, out + begin, 0);
+            if (result != out + begin) {
+                std::copy(result, result + count, out + begin);
+            }
+        }
+    }
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "hash.hxx"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Hit, miss and eviction counters of a cache.
+struct CacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::size_t size = 0;
+    std::size_t bytes = 0; // Approximate memory held, where the cache tracks it.
+};
+
+// Bounded, concurrent cache of evaluation results.
+//
+// An entry is keyed by the expression and remembers the identifiers the expression reads together with their
+// versions in the variable table when the result was computed. A lookup is a hit if the table version has not
+// moved since the entry was last validated or, failing that, if none of the expression's own identifiers has
+// changed, so updates to unrelated variables do not invalidate anything. Results are computed inside a
+// snapshot read, so the recorded versions always match the values used. Expressions that read variables bound
+// to outside memory are never cached, since those change without a version.
+//
+// Expressions are keyed by structure (structuralHash() plus a sameTree() check against a private copy), so
+// separately built copies of a formula share one entry; canonicalize() trees first to also match a + b with
+// b + a. Entries are spread over shards, each with its own lock and CLOCK eviction.
+class ResultCache {
+    struct Entry {
+        std::uint64_t hash;
+        std::unique_ptr<const ASTNode> tree;        // Private copy of the expression.
+        std::vector<VariableStore::Symbol> symbols; // Identifiers the expression reads.
+        std::vector<std::uint64_t> versions;        // Their versions when value was computed.
+        std::uint64_t tableVersion;                 // Table version at which the entry was last known valid.
+        double value;
+        bool referenced;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Entry> entries;
+        std::unordered_map<std::uint64_t, std::size_t> index;
+        std::size_t hand = 0; // CLOCK hand.
+    };
+
+    VariableStore &store; // The global variable table.
+    std::size_t shardCapacity;
+    std::vector<Shard> shards;
+    std::atomic<std::uint64_t> hits{0}, misses{0}, evictions{0};
+
+    Shard &shardFor(std::uint64_t hash) { return shards[(hash >> 32) % shards.size()]; }
+
+    // Returns the entry for node in shard, or nullptr. Caller holds shard.mutex.
+    static Entry *find(Shard &shard, std::uint64_t hash, const ASTNode &node) {
+        auto it = shard.index.find(hash);
+        if (it == shard.index.end()) {
+            return nullptr;
+        }
+        // Compare the trees as well, so a hash collision never returns another expression's result.
+        Entry &entry = shard.entries[it->second];
+        return sameTree(*entry.tree, node) ? &entry : nullptr;
+    }
+
+    // Collects the distinct identifiers of a tree.
+    static void collectSymbols(const ASTNode &node, std::vector<VariableStore::Symbol> &symbols) {
+        if (node.getType() == ASTNode::Type::Identifier) {
+            VariableStore::Symbol symbol = static_cast<const Identifier &>(node).getSymbol();
+            if (std::find(symbols.begin(), symbols.end(), symbol) == symbols.end()) {
+                symbols.push_back(symbol);
+            }
+            return;
+        }
+        forEachChild(node, [&](const ASTNode &child) { collectSymbols(child, symbols); });
+    }
+
+    // Returns true if entry is still valid at tableVersion, refreshing its table version if so.
+    bool validate(Entry &entry, std::uint64_t tableVersion) const {
+        if (entry.tableVersion == tableVersion) {
+            return true;
+        }
+        for (std::size_t i = 0; i < entry.symbols.size(); ++i) {
+            if (store.isBound(entry.symbols[i]) || store.getVersion(entry.symbols[i]) != entry.versions[i]) {
+                return false;
+            }
+        }
+        entry.tableVersion = tableVersion;
+        return true;
+    }
+
+    // Stores entry in shard, evicting with the CLOCK policy if the shard is full. Caller holds shard.mutex.
+    void insert(Shard &shard, Entry entry) {
+        auto it = shard.index.find(entry.hash);
+        if (it != shard.index.end()) {
+            shard.entries[it->second] = std::move(entry);
+            return;
+        }
+        if (shard.entries.size() < shardCapacity) {
+            shard.index.emplace(entry.hash, shard.entries.size());
+            shard.entries.push_back(std::move(entry));
+            return;
+        }
+        while (shard.entries[shard.hand].referenced) {
+            shard.entries[shard.hand].referenced = false;
+            shard.hand = (shard.hand + 1) % shard.entries.size();
+        }
+        shard.index.erase(shard.entries[shard.hand].hash);
+        shard.index.emplace(entry.hash, shard.hand);
+        shard.entries[shard.hand] = std::move(entry);
+        shard.hand = (shard.hand + 1) % shard.entries.size();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+  public:
+    // Creates a cache holding up to about capacity results, split over shardCount independently locked shards.
+    // Results are validated against the global variable table, the one Identifier::evaluate() reads.
+    explicit ResultCache(std::size_t capacity, std::size_t shardCount = 16)
+        : store(Identifier::getVariableStore()),
+          shardCapacity(std::max<std::size_t>(1, capacity / std::max<std::size_t>(1, shardCount))),
+          shards(std::max<std::size_t>(1, shardCount)) {}
+
+    // Returns node.evaluate(), from the cache if none of the identifiers it reads has changed.
+    double evaluate(const ASTNode &node) {
+        std::uint64_t hash = structuralHash(node);
+        Shard &shard = shardFor(hash);
+        std::uint64_t tableVersion = store.getVersion();
+        std::vector<VariableStore::Symbol> symbols;
+        bool known = false;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (Entry *entry = find(shard, hash, node)) {
+                if (validate(*entry, tableVersion)) {
+                    entry->referenced = true;
+                    hits.fetch_add(1, std::memory_order_relaxed);
+                    return entry->value;
+                }
+                symbols = entry->symbols;
+                known = true;
+            }
+        }
+
+        misses.fetch_add(1, std::memory_order_relaxed);
+        if (!known) {
+            collectSymbols(node, symbols);
+        }
+        for (VariableStore::Symbol symbol : symbols) {
+            if (store.isBound(symbol)) {
+                return node.evaluate();
+            }
+        }
+
+        // Evaluate at a consistent snapshot, so the versions recorded are those of the values used.
+        std::vector<std::uint64_t> versions(symbols.size());
+        double value = store.read([&] {
+            tableVersion = store.getVersion();
+            for (std::size_t i = 0; i < symbols.size(); ++i) {
+                versions[i] = store.getVersion(symbols[i]);
+            }
+            return node.evaluate();
+        });
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        insert(shard, Entry{hash, clone(node), std::move(symbols), std::move(versions), tableVersion, value,
+                            false});
+        return value;
+    }
+
+    // Drops the entry of node (or of any tree with the same structure), if any.
+    void forget(const ASTNode &node) {
+        std::uint64_t hash = structuralHash(node);
+        Shard &shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(hash);
+        if (it == shard.index.end() || !sameTree(*shard.entries[it->second].tree, node)) {
+            return;
+        }
+        // Move the last entry into the hole so entries stay contiguous.
+        std::size_t hole = it->second;
+        shard.index.erase(it);
+        if (hole != shard.entries.size() - 1) {
+            shard.entries[hole] = std::move(shard.entries.back());
+            shard.index[shard.entries[hole].hash] = hole;
+        }
+        shard.entries.pop_back();
+        shard.hand = shard.entries.empty() ? 0 : shard.hand % shard.entries.size();
+    }
+
+    // Drops every entry.
+    void clear() {
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+            shard.index.clear();
+            shard.hand = 0;
+        }
+    }
+
+    // Current counters and number of cached results.
+    CacheStats getStats() {
+        CacheStats stats;
+        stats.hits = hits.load(std::memory_order_relaxed);
+        stats.misses = misses.load(std::memory_order_relaxed);
+        stats.evictions = evictions.load(std::memory_order_relaxed);
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            stats.size += shard.entries.size();
+        }
+        return stats;
+    }
+};
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "mapping.hxx"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Columnar file format for evaluation inputs and outputs.
+//
+// Layout (little-endian, offsets relative to the start of the file):
+//
+//     columnar::Header           magic, version, byte-order mark, column, row and row-group counts, offsets
+//     row group 0                one 64-byte-aligned block of rows doubles per column, in column order
+//     row group 1 ...
+//     uint32[columns + 1], chars column name table (offsets into the character data that follows)
+//     columnar::Group[groups]    first row, row count and data offset of every row group
+//
+// Row groups are written as they fill, and the name and group tables go at the end, so a file of any size is
+// written in one pass with bounded memory. Readers map the file and use the column blocks in place.
+namespace columnar {
+
+constexpr char magic[8] = {'A', 'S', 'T', 'C', 'O', 'L', '\0', '\0'};
+constexpr std::uint32_t formatVersion = 1;
+constexpr std::uint32_t byteOrderMark = 0x01020304;
+constexpr std::size_t alignment = 64;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t columnCount;
+    std::uint32_t groupCount;
+    std::uint64_t rowCount;
+    std::uint64_t namesOffset;
+    std::uint64_t groupsOffset;
+    std::uint64_t reserved[2];
+};
+
+struct Group {
+    std::uint64_t firstRow;
+    std::uint64_t rowCount;
+    std::uint64_t offset;
+};
+
+static_assert(sizeof(Header) == alignment && sizeof(Group) == 24, "packed layout");
+
+// Bytes one column of a row group occupies, padded to the alignment.
+inline std::uint64_t columnBytes(std::uint64_t rows) {
+    return (rows * sizeof(double) + alignment - 1) / alignment * alignment;
+}
+
+} // namespace columnar
+
+// Writes a columnar file, one row group at a time. The file is written under a temporary name and renamed into
+// place by close(), so readers never see a partial file.
+class ColumnarWriter {
+    std::string path, temporary;
+    std::FILE *file;
+    std::vector<std::string> names;
+    std::size_t groupRows;
+    std::vector<std::vector<double>> pending; // Rows of the group being filled, per column.
+    std::size_t pendingRows = 0;
+    std::vector<columnar::Group> groups;
+    std::uint64_t rowCount = 0, offset = 0;
+
+    void put(const void *data, std::size_t size) {
+        if (std::fwrite(data, 1, size, file) != size) {
+            throw std::runtime_error("ColumnarWriter: cannot write " + temporary);
+        }
+        offset += size;
+    }
+
+    void pad() {
+        static const char zeros[columnar::alignment] = {};
+        put(zeros, (columnar::alignment - offset % columnar::alignment) % columnar::alignment);
+    }
+
+    void flushGroup() {
+        if (pendingRows == 0) {
+            return;
+        }
+        groups.push_back(columnar::Group{rowCount, pendingRows, offset});
+        for (std::vector<double> &column : pending) {
+            put(column.data(), pendingRows * sizeof(double));
+            pad();
+        }
+        rowCount += pendingRows;
+        pendingRows = 0;
+    }
+
+  public:
+    // Creates path with the given column names, starting a new row group every groupRows rows.
+    ColumnarWriter(std::string path, std::vector<std::string> names, std::size_t groupRows = 1 << 16)
+        : path(std::move(path)), names(std::move(names)), groupRows(std::max<std::size_t>(1, groupRows)),
+          pending(this->names.size(), std::vector<double>(this->groupRows)) {
+        static std::atomic<unsigned> sequence{0};
+        temporary = this->path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(sequence++);
+        file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr) {
+            throw std::system_error(errno, std::generic_category(), "fopen " + temporary);
+        }
+        columnar::Header header{};
+        put(&header, sizeof(header)); // Rewritten by close().
+    }
+
+    ColumnarWriter(const ColumnarWriter &) = delete;
+    ColumnarWriter &operator=(const ColumnarWriter &) = delete;
+
+    // Discards the file if close() was not called.
+    ~ColumnarWriter() {
+        if (file != nullptr) {
+            std::fclose(file);
+            std::remove(temporary.c_str());
+        }
+    }
+
+    // Appends rows rows; columns[c] points at the values of column c.
+    void append(const double *const *columns, std::size_t rows) {
+        for (std::size_t done = 0; done < rows;) {
+            std::size_t count = std::min(rows - done, groupRows - pendingRows);
+            for (std::size_t c = 0; c < names.size(); ++c) {
+                std::copy(columns[c] + done, columns[c] + done + count, pending[c].begin() + pendingRows);
+            }
+            pendingRows += count;
+            done += count;
+            if (pendingRows == groupRows) {
+                flushGroup();
+            }
+        }
+    }
+
+    // Writes the last row group and the tables, and moves the file into place.
+    void close() {
+        flushGroup();
+        columnar::Header header{};
+        std::copy(std::begin(columnar::magic), std::end(columnar::magic), header.magic);
+        header.version = columnar::formatVersion;
+        header.byteOrder = columnar::byteOrderMark;
+        header.columnCount = static_cast<std::uint32_t>(names.size());
+        header.groupCount = static_cast<std::uint32_t>(groups.size());
+        header.rowCount = rowCount;
+
+        header.namesOffset = offset;
+        std::vector<std::uint32_t> offsets{0};
+        std::string characters;
+        for (const std::string &name : names) {
+            characters += name;
+            offsets.push_back(static_cast<std::uint32_t>(characters.size()));
+        }
+        put(offsets.data(), offsets.size() * sizeof(std::uint32_t));
+        put(characters.data(), characters.size());
+        put("\0\0\0\0\0\0\0", (8 - offset % 8) % 8);
+        header.groupsOffset = offset;
+        put(groups.data(), groups.size() * sizeof(columnar::Group));
+
+        bool written = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+        written = std::fclose(file) == 0 && written;
+        file = nullptr;
+        if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("ColumnarWriter: cannot write " + path);
+        }
+    }
+};
+
+// A columnar file mapped into memory. Column blocks are read in place, with no copy or conversion.
+class ColumnarFile {
+    FileMapping file;
+    const columnar::Header *header;
+    const columnar::Group *groups;
+    std::vector<std::string> names;
+
+    [[noreturn]] static void reject(const std::string &reason) {
+        throw std::runtime_error("ColumnarFile: " + reason);
+    }
+
+  public:
+    // Maps and validates the file at path; throws std::runtime_error if it is not a valid columnar file.
+    explicit ColumnarFile(const std::string &path) : file(path) {
+        std::size_t size = file.size();
+        if (size < sizeof(columnar::Header)) {
+            reject("truncated file " + path);
+        }
+        header = reinterpret_cast<const columnar::Header *>(file.data());
+        if (!std::equal(std::begin(columnar::magic), std::end(columnar::magic), header->magic)) {
+            reject("not a columnar file: " + path);
+        }
+        if (header->version != columnar::formatVersion || header->byteOrder != columnar::byteOrderMark) {
+            reject("unsupported format version or byte order");
+        }
+        if (header->groupsOffset % 8 != 0 || header->groupsOffset > size ||
+            header->groupCount > (size - header->groupsOffset) / sizeof(columnar::Group) ||
+            header->namesOffset > size ||
+            std::uint64_t(header->columnCount) + 1 > (size - header->namesOffset) / sizeof(std::uint32_t)) {
+            reject("tables out of bounds");
+        }
+        groups = reinterpret_cast<const columnar::Group *>(file.data() + header->groupsOffset);
+        std::uint64_t rows = 0;
+        for (std::uint32_t g = 0; g < header->groupCount; ++g) {
+            const columnar::Group &group = groups[g];
+            if (group.firstRow != rows || group.offset % columnar::alignment != 0 || group.offset > size ||
+                group.rowCount > size / sizeof(double) ||
+                header->columnCount * columnar::columnBytes(group.rowCount) > size - group.offset) {
+                reject("row group out of bounds");
+            }
+            rows += group.rowCount;
+        }
+        if (rows != header->rowCount) {
+            reject("row count mismatch");
+        }
+        const auto *offsets = reinterpret_cast<const std::uint32_t *>(file.data() + header->namesOffset);
+        const char *characters = reinterpret_cast<const char *>(offsets + header->columnCount + 1);
+        std::size_t available = static_cast<std::size_t>(file.data() + size - characters);
+        for (std::uint32_t c = 0; c < header->columnCount; ++c) {
+            if (offsets[c] > offsets[c + 1] || offsets[c + 1] > available) {
+                reject("name table out of bounds");
+            }
+            names.emplace_back(characters + offsets[c], offsets[c + 1] - offsets[c]);
+        }
+        file.adviseSequential();
+    }
+
+    // Column names.
+    const std::vector<std::string> &getNames() const { return names; }
+
+    // Total number of rows.
+    std::uint64_t getRowCount() const { return header->rowCount; }
+
+    // Number of row groups.
+    std::size_t getGroupCount() const { return header->groupCount; }
+
+    // Number of rows in row group g.
+    std::size_t getGroupRows(std::size_t g) const { return groups[g].rowCount; }
+
+    // The values of column c in row group g, 64-byte aligned.
+    const double *column(std::size_t g, std::size_t c) const {
+        return reinterpret_cast<const double *>(file.data() + groups[g].offset +
+                                                c * columnar::columnBytes(groups[g].rowCount));
+    }
+};
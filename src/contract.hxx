@@ -0,0 +1,48 @@
+#pragma once
+
+#include "transform.hxx"
+
+// Fused multiply-add contraction pass.
+//
+// Rewrites a * b + c, c + a * b, a * b - c and c - a * b into MultiplyAdd nodes, which evaluate with a single
+// rounding through std::fma. Results can differ in the last bit from the uncontracted tree, so the pass is
+// opt-in: callers that need bit-for-bit reproducibility simply do not run it. Run it after optimize(), which
+// does not accept MultiplyAdd nodes.
+inline std::unique_ptr<const ASTNode> contractMultiplyAdd(std::unique_ptr<const ASTNode> node) {
+    ASTNode::Type type = node->getType();
+    if (!isBinary(type)) {
+        rewriteChildren(node, [](std::unique_ptr<const ASTNode> child) {
+            return contractMultiplyAdd(std::move(child));
+        });
+        return node;
+    }
+
+    Binary &binary = mutableBinary(node);
+    std::unique_ptr<const ASTNode> left = contractMultiplyAdd(binary.releaseLeft());
+    std::unique_ptr<const ASTNode> right = contractMultiplyAdd(binary.releaseRight());
+    bool leftProduct = left->getType() == ASTNode::Type::Multiply;
+    bool rightProduct = right->getType() == ASTNode::Type::Multiply;
+
+    if ((type == ASTNode::Type::Add || type == ASTNode::Type::Subtract) && (leftProduct || rightProduct)) {
+        // Pick the product operand, preferring the left one.
+        std::unique_ptr<const ASTNode> product = leftProduct ? std::move(left) : std::move(right);
+        std::unique_ptr<const ASTNode> addend = leftProduct ? std::move(right) : std::move(left);
+        Binary &multiply = mutableBinary(product);
+        std::unique_ptr<const ASTNode> a = multiply.releaseLeft();
+        std::unique_ptr<const ASTNode> b = multiply.releaseRight();
+
+        if (type == ASTNode::Type::Subtract) {
+            // a * b - c -> fma(a, b, -c) and c - a * b -> fma(-a, b, c); negation is exact.
+            if (leftProduct) {
+                addend = std::make_unique<UnaryMinus>(std::move(addend));
+            } else {
+                a = std::make_unique<UnaryMinus>(std::move(a));
+            }
+        }
+        return std::make_unique<MultiplyAdd>(std::move(a), std::move(b), std::move(addend));
+    }
+
+    binary.resetLeft(std::move(left));
+    binary.resetRight(std::move(right));
+    return node;
+}
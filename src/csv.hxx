@@ -0,0 +1,269 @@
+#pragma once
+
+#include "mapping.hxx"
+#include "transform.hxx"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+// Bit i of the result is set if p[i] is the delimiter or a newline, for the 64 bytes at p. Portable version:
+// each 8-byte word is compared with both needles at once (exact zero-byte test, then the high bit of every
+// byte gathered into 8 mask bits with one multiply).
+inline std::uint64_t structuralMaskScalar(const char *p, char delimiter) {
+    constexpr std::uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL, ones = 0x0101010101010101ULL;
+    const std::uint64_t newlines = ones * '\n', separators = ones * static_cast<unsigned char>(delimiter);
+    auto zeroBytes = [](std::uint64_t x) { return ~(((x & low7) + low7) | x | low7); };
+    std::uint64_t mask = 0;
+    for (int i = 0; i < 8; ++i) {
+        std::uint64_t word;
+        std::memcpy(&word, p + 8 * i, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        std::uint64_t high = zeroBytes(word ^ newlines) | zeroBytes(word ^ separators);
+        mask |= ((high >> 7) * 0x0102040810204080ULL) >> 56 << (8 * i);
+    }
+    return mask;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// AVX2 version of structuralMaskScalar: two 32-byte compares per needle and a movemask each.
+__attribute__((target("avx2"))) inline std::uint64_t structuralMaskAvx2(const char *p, char delimiter) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i separator = _mm256_set1_epi8(delimiter);
+    __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+    std::uint32_t lowMask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(low, newline), _mm256_cmpeq_epi8(low, separator))));
+    std::uint32_t highMask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(high, newline), _mm256_cmpeq_epi8(high, separator))));
+    return lowMask | std::uint64_t(highMask) << 32;
+}
+#endif
+
+// The structural mask function for this CPU, chosen once.
+inline std::uint64_t (*structuralMask())(const char *, char) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    static const auto function = __builtin_cpu_supports("avx2") ? structuralMaskAvx2 : structuralMaskScalar;
+    return function;
+#else
+    return structuralMaskScalar;
+#endif
+}
+
+// Reads numeric CSV or TSV data into column buffers, a chunk of rows at a time.
+//
+// The first line names the columns. The input is scanned 64 bytes at a time into a bit mask of delimiter and
+// newline positions (with AVX2 where available), and the fields between consecutive positions are parsed
+// with std::from_chars straight into preallocated column buffers, so no field is copied or allocated.
+// Columns that are not selected are skipped without parsing. Empty fields read as NaN; surrounding spaces
+// and a trailing '\r' are ignored; blank lines are skipped. Quoted fields are not supported. Malformed
+// numbers or rows with the wrong number of fields throw std::runtime_error with the line number.
+class CsvReader {
+    std::unique_ptr<FileMapping> file;
+    const char *position; // Start of the next unread line.
+    const char *end;
+    char delimiter;
+    std::size_t line = 1; // Line number of position.
+    std::vector<std::string> names;
+    std::vector<bool> selected;
+    std::vector<std::vector<double>> columns;
+    std::uint64_t (*maskOf)(const char *, char) = structuralMask();
+
+    [[noreturn]] void fail(const std::string &message) const {
+        throw std::runtime_error("CSV line " + std::to_string(line) + ": " + message);
+    }
+
+    static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    // Structural mask of the 64 bytes at block, reading a padded copy where fewer than 64 bytes remain.
+    std::uint64_t blockMask(const char *block) const {
+        if (end - block >= 64) {
+            return maskOf(block, delimiter);
+        }
+        char padded[64] = {};
+        std::copy(block, end, padded);
+        return maskOf(padded, delimiter) & ((std::uint64_t(1) << (end - block)) - 1);
+    }
+
+    // Trims spaces, tabs and '\r' that are not the delimiter.
+    void trim(const char *&first, const char *&last) const {
+        while (first < last && isBlank(*first) && *first != delimiter) {
+            ++first;
+        }
+        while (last > first && isBlank(last[-1]) && last[-1] != delimiter) {
+            --last;
+        }
+    }
+
+    double parseField(const char *first, const char *last) const {
+        trim(first, last);
+        if (first == last) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        if (*first == '+') {
+            ++first;
+        }
+        double value;
+        auto result = std::from_chars(first, last, value);
+        if (result.ec != std::errc() || result.ptr != last) {
+            fail("malformed number '" + std::string(first, last) + "'");
+        }
+        return value;
+    }
+
+    void readHeader() {
+        if (position == end) {
+            return;
+        }
+        const char *lineEnd = std::find(position, end, '\n');
+        for (const char *first = position;;) {
+            const char *last = std::find(first, lineEnd, delimiter);
+            const char *nameStart = first, *nameEnd = last;
+            trim(nameStart, nameEnd);
+            names.emplace_back(nameStart, nameEnd);
+            if (last == lineEnd) {
+                break;
+            }
+            first = last + 1;
+        }
+        position = lineEnd + (lineEnd < end);
+        ++line;
+        selected.assign(names.size(), true);
+        columns.resize(names.size());
+    }
+
+  public:
+    // Reads the in-memory text at data, which must outlive the reader.
+    CsvReader(const char *data, std::size_t size, char delimiter = ',')
+        : position(data), end(data + size), delimiter(delimiter) {
+        readHeader();
+    }
+
+    // Maps the file at path, with the delimiter given by delimiterFor(path).
+    explicit CsvReader(const std::string &path)
+        : file(std::make_unique<FileMapping>(path)), position(file->data()), end(file->data() + file->size()),
+          delimiter(delimiterFor(path)) {
+        file->adviseSequential();
+        readHeader();
+    }
+
+    // The delimiter of a file: a tab for *.tsv files and a comma otherwise.
+    static char delimiterFor(const std::string &path) {
+        return path.size() >= 4 && path.compare(path.size() - 4, 4, ".tsv") == 0 ? '\t' : ',';
+    }
+
+    // Continues with the rows in the in-memory text at data, which must outlive the reads from it. Used to feed
+    // a file in pieces; each piece but the last must end with a newline.
+    void resume(const char *data, std::size_t size) {
+        position = data;
+        end = data + size;
+    }
+
+    // Column names from the first line.
+    const std::vector<std::string> &getNames() const { return names; }
+
+    // Parses only the columns that expression reads; the others are skipped.
+    void selectColumns(const ASTNode &expression) {
+        std::vector<std::string> used;
+        auto collect = [&](const ASTNode &node, auto &self) -> void {
+            if (node.getType() == ASTNode::Type::Identifier) {
+                used.push_back(static_cast<const Identifier &>(node).getIdentifier());
+            }
+            forEachChild(node, [&](const ASTNode &child) { self(child, self); });
+        };
+        collect(expression, collect);
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            selected[i] = std::find(used.begin(), used.end(), names[i]) != used.end();
+        }
+    }
+
+    // Returns true if column i is parsed.
+    bool isSelected(std::size_t i) const { return selected[i]; }
+
+    // Values of column i from the last read(); empty if the column is not selected.
+    const double *column(std::size_t i) const { return columns[i].data(); }
+
+    // Parses up to maxRows rows into the selected columns; returns the number of rows read, 0 at the end.
+    std::size_t read(std::size_t maxRows) {
+        std::vector<double *> targets(names.size());
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            columns[i].resize(selected[i] ? maxRows : 0);
+            targets[i] = columns[i].data();
+        }
+        return read(maxRows, targets.data());
+    }
+
+    // Like read(maxRows), but parses column i into targets[i], which must have room for maxRows values if the
+    // column is selected. column() is not updated.
+    std::size_t read(std::size_t maxRows, double *const *targets) {
+        std::size_t rows = 0, field = 0;
+        const char *fieldStart = position;
+        // Ends the field [fieldStart, fieldEnd) and, at a newline, the row.
+        auto endField = [&](const char *fieldEnd, bool endOfRow) {
+            if (endOfRow && field == 0) {
+                const char *first = fieldStart;
+                trim(first, fieldEnd);
+                if (first == fieldEnd) { // Blank line.
+                    ++line;
+                    return;
+                }
+            }
+            if (field == names.size()) {
+                fail("more than " + std::to_string(names.size()) + " fields");
+            }
+            if (selected[field]) {
+                targets[field][rows] = parseField(fieldStart, fieldEnd);
+            }
+            ++field;
+            if (endOfRow) {
+                if (field != names.size()) {
+                    fail("expected " + std::to_string(names.size()) + " fields, found " + std::to_string(field));
+                }
+                field = 0;
+                ++rows;
+                ++line;
+            }
+        };
+        for (const char *block = position; block < end && rows < maxRows; block += 64) {
+            for (std::uint64_t mask = blockMask(block); mask != 0 && rows < maxRows; mask &= mask - 1) {
+                const char *separator = block + __builtin_ctzll(mask);
+                bool endOfRow = *separator == '\n';
+                endField(separator, endOfRow);
+                fieldStart = separator + 1;
+                if (endOfRow) {
+                    position = fieldStart;
+                }
+            }
+        }
+        if (rows < maxRows && (field > 0 || fieldStart < end)) { // A last line without a newline.
+            endField(end, true);
+            position = end;
+        }
+        return rows;
+    }
+};
+
+// Throws std::runtime_error naming the first identifier of expression that is neither one of the column names nor
+// set in the variable store, so a misspelt column fails instead of evaluating every row with a missing value.
+inline void requireColumns(const ASTNode &expression, const std::vector<std::string> &names) {
+    auto check = [&](const ASTNode &node, auto &self) -> void {
+        if (node.getType() == ASTNode::Type::Identifier) {
+            const auto &identifier = static_cast<const Identifier &>(node);
+            double value;
+            if (std::find(names.begin(), names.end(), identifier.getIdentifier()) == names.end() &&
+                !Identifier::getVariableStore().get(identifier.getSymbol(), value)) {
+                throw std::runtime_error("no column named '" + identifier.getIdentifier() + "' in the input");
+            }
+        }
+        forEachChild(node, [&](const ASTNode &child) { self(child, self); });
+    };
+    check(expression, check);
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "program.hxx"
+#include "serialize.hxx"
+#include <cstdio>
+#include <sys/stat.h>
+
+// Bit set of the CPU features that compiled programs may be tuned for. Cached programs built under a different
+// set are not reused.
+inline std::uint64_t cpuFeatures() {
+    std::uint64_t features = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    features |= __builtin_cpu_supports("sse4.2") ? 1u : 0u;
+    features |= __builtin_cpu_supports("avx") ? 2u : 0u;
+    features |= __builtin_cpu_supports("avx2") ? 4u : 0u;
+    features |= __builtin_cpu_supports("fma") ? 8u : 0u;
+    features |= __builtin_cpu_supports("avx512f") ? 16u : 0u;
+#endif
+    return features;
+}
+
+// Directory of compiled programs that survives restarts.
+//
+// Each expression text is compiled once (by default parsed and simplified) and its tree stored as a program image in
+// <directory>/<text hash>-<compiler tag hash>-<features>.prog, behind a small header holding the entry format version,
+// the CPU feature set, the compiler tag and the text itself. The tag names the compiler and its version, so caches with
+// different pipelines can share a directory and a new optimizer ignores old trees. A later lookup, in this or another
+// process, reads the file, checks the header, the tag, the text and the image checksum, and rebuilds the tree without
+// parsing or optimizing. Files that fail any check are recompiled and replaced. Entries are only read when first looked
+// up; pass compiler() to a ProgramCache to keep them in memory afterwards.
+class DiskProgramCache {
+    struct EntryHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t textLength;
+        std::uint64_t features;
+        std::uint32_t tagLength;
+        std::uint32_t reserved;
+    };
+
+    static constexpr char entryMagic[8] = {'A', 'S', 'T', 'P', 'R', 'O', 'G', '\0'};
+    static constexpr std::uint32_t entryVersion = 2;
+
+    std::string directory;
+    std::string tag; // Names the compiler and its version.
+    ProgramCache::Compiler compile;
+    std::uint64_t features;
+    std::atomic<std::uint64_t> hits{0}, misses{0};
+
+    // Offset of the image in an entry, after the header, the tag and the text.
+    std::size_t imageOffset(std::size_t textLength) const {
+        return (sizeof(EntryHeader) + tag.size() + textLength + 7) / 8 * 8;
+    }
+
+    // Returns the stored tree for text, or nullptr if the file is missing, stale or corrupt. Entries are small, so
+    // one read into an aligned buffer is cheaper than setting up and tearing down a mapping.
+    std::unique_ptr<const ASTNode> read(const std::string &path, std::string_view text) const {
+        int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0) {
+            return nullptr;
+        }
+        struct stat status;
+        std::vector<std::uint64_t> buffer;
+        std::size_t size = 0;
+        if (fstat(descriptor, &status) == 0 && status.st_size >= static_cast<off_t>(imageOffset(text.size()))) {
+            size = static_cast<std::size_t>(status.st_size);
+            buffer.resize((size + 7) / 8);
+            if (pread(descriptor, buffer.data(), size, 0) != static_cast<ssize_t>(size)) {
+                size = 0;
+            }
+        }
+        close(descriptor);
+        if (size == 0) {
+            return nullptr;
+        }
+        const char *data = reinterpret_cast<const char *>(buffer.data());
+        const auto *header = reinterpret_cast<const EntryHeader *>(data);
+        if (!std::equal(std::begin(entryMagic), std::end(entryMagic), header->magic) ||
+            header->version != entryVersion || header->features != features || header->tagLength != tag.size() ||
+            header->textLength != text.size() || std::string_view(data + sizeof(EntryHeader), tag.size()) != tag ||
+            std::string_view(data + sizeof(EntryHeader) + tag.size(), text.size()) != text) {
+            return nullptr;
+        }
+        try {
+            std::size_t offset = imageOffset(text.size());
+            ProgramImage image(data + offset, size - offset);
+            return image.size() == 1 ? image.toTree(0) : nullptr;
+        } catch (const std::runtime_error &) {
+            return nullptr;
+        }
+    }
+
+    void write(const std::string &path, std::string_view text, const ASTNode &tree) const {
+        ProgramImageWriter writer;
+        writer.add(tree);
+        std::vector<char> image = writer.finish();
+        EntryHeader header{};
+        std::copy(std::begin(entryMagic), std::end(entryMagic), header.magic);
+        header.version = entryVersion;
+        header.textLength = static_cast<std::uint32_t>(text.size());
+        header.features = features;
+        header.tagLength = static_cast<std::uint32_t>(tag.size());
+        std::vector<char> bytes(imageOffset(text.size()) + image.size());
+        std::copy(reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header + 1), bytes.begin());
+        std::copy(tag.begin(), tag.end(), bytes.begin() + sizeof(EntryHeader));
+        std::copy(text.begin(), text.end(), bytes.begin() + sizeof(EntryHeader) + tag.size());
+        std::copy(image.begin(), image.end(), bytes.begin() + imageOffset(text.size()));
+        writeFileReplacing(path, bytes.data(), bytes.size());
+    }
+
+  public:
+    // Tag of the default compiler, parseExpression followed by simplify.
+    static constexpr const char *defaultTag = "parse+simplify/1";
+
+    // Uses directory, creating it if needed, with the default compiler.
+    explicit DiskProgramCache(std::string directory)
+        : DiskProgramCache(std::move(directory), defaultTag,
+                           [](std::string_view text) { return simplify(parseExpression(text)); }) {}
+
+    // Uses directory, creating it if needed, with compile turning text into the tree to store. tag identifies
+    // compile and must change whenever its output may change, for example with a new optimizer version.
+    DiskProgramCache(std::string directory, std::string tag, ProgramCache::Compiler compile)
+        : directory(std::move(directory)), tag(std::move(tag)), compile(std::move(compile)), features(cpuFeatures()) {
+        if (mkdir(this->directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::system_error(errno, std::generic_category(), "mkdir " + this->directory);
+        }
+    }
+
+    // File holding the compiled program for text.
+    std::string pathFor(std::string_view text) const {
+        char name[64];
+        std::snprintf(name, sizeof(name), "/%016llx-%016llx-%llx.prog", static_cast<unsigned long long>(hashName(text)),
+                      static_cast<unsigned long long>(hashName(tag)), static_cast<unsigned long long>(features));
+        return directory + name;
+    }
+
+    // Returns the compiled tree for text, from the directory if a valid entry exists, otherwise compiling and
+    // storing it. Compile errors propagate; failures to store are ignored, since the entry is only a cache.
+    std::unique_ptr<const ASTNode> load(std::string_view text) {
+        std::string path = pathFor(text);
+        if (std::unique_ptr<const ASTNode> tree = read(path, text)) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return tree;
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        std::unique_ptr<const ASTNode> tree = compile(text);
+        try {
+            write(path, text, *tree);
+        } catch (const std::exception &) {
+        }
+        return tree;
+    }
+
+    // A ProgramCache compiler that goes through this directory. The cache must outlive the returned function.
+    ProgramCache::Compiler compiler() {
+        return [this](std::string_view text) { return load(text); };
+    }
+
+    // Entries found valid on disk (hits) and compiled (misses).
+    CacheStats getStats() const {
+        CacheStats stats;
+        stats.hits = hits.load(std::memory_order_relaxed);
+        stats.misses = misses.load(std::memory_order_relaxed);
+        return stats;
+    }
+};
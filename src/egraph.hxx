@@ -0,0 +1,382 @@
+#pragma once
+
+#include "transform.hxx"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Default per-operation cost used to pick the cheapest equivalent tree.
+inline double defaultOperationCost(ASTNode::Type type) {
+    switch (type) {
+    case ASTNode::Type::Power:
+        return 40.0;
+    case ASTNode::Type::Divide:
+        return 8.0;
+    case ASTNode::Type::Multiply:
+        return 2.0;
+    default:
+        return 1.0;
+    }
+}
+
+// Total cost of a tree under a per-operation cost model.
+inline double treeCost(const ASTNode &node, double (*cost)(ASTNode::Type) = defaultOperationCost) {
+    double total = cost(node.getType());
+    forEachChild(node, [&](const ASTNode &child) { total += treeCost(child, cost); });
+    return total;
+}
+
+// Options for equality saturation.
+//
+// The rule set includes associativity and distributivity, which can change rounding, so the optimizer is
+// meant for callers that accept fast-math results.
+struct EGraphOptions {
+    std::size_t maxNodes = 20000;               // Stop exploring once the e-graph holds this many e-nodes.
+    std::size_t maxIterations = 12;             // Upper bound on rule application rounds.
+    std::chrono::microseconds timeBudget{2000}; // Wall-clock budget for exploration.
+    double (*cost)(ASTNode::Type) = defaultOperationCost;
+};
+
+// Equality graph over the AST node set.
+//
+// Each e-class is a set of equivalent e-nodes; an e-node is an operation whose operands are e-classes.
+// Classes are merged with a union-find and congruence is restored by rebuild() after every round.
+class EGraph {
+  public:
+    // A single operation with e-class operands.
+    struct ENode {
+        ASTNode::Type type;
+        double value = 0.0;     // Constant value.
+        std::size_t symbol = 0; // Identifier index into the symbol list.
+        std::size_t arity = 0;
+        std::size_t children[2] = {0, 0};
+
+        bool operator==(const ENode &other) const {
+            return type == other.type && std::memcmp(&value, &other.value, sizeof(double)) == 0 &&
+                   symbol == other.symbol && arity == other.arity && children[0] == other.children[0] &&
+                   children[1] == other.children[1];
+        }
+    };
+
+  private:
+    struct ENodeHash {
+        std::size_t operator()(const ENode &node) const {
+            std::uint64_t bits;
+            std::memcpy(&bits, &node.value, sizeof(bits));
+            std::size_t h = static_cast<std::size_t>(node.type);
+            for (std::uint64_t part : {bits, std::uint64_t(node.symbol), std::uint64_t(node.children[0]),
+                                       std::uint64_t(node.children[1])}) {
+                h ^= std::hash<std::uint64_t>()(part) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            }
+            return h;
+        }
+    };
+
+    std::vector<std::size_t> parent;         // Union-find over class ids.
+    std::vector<std::vector<ENode>> classes; // E-nodes of each canonical class.
+    std::unordered_map<ENode, std::size_t, ENodeHash> memo;
+    std::vector<std::string> symbols;
+    std::unordered_map<std::string, std::size_t> symbolIds;
+    std::size_t nodeCount = 0;
+    std::size_t mergeCount = 0;
+
+    // Rewrites the operands of node to their canonical classes.
+    ENode canonical(ENode node) {
+        for (std::size_t i = 0; i < node.arity; ++i) {
+            node.children[i] = find(node.children[i]);
+        }
+        return node;
+    }
+
+    // Finds a constant e-node in a class.
+    bool constantOf(std::size_t id, double &value) {
+        for (const ENode &node : classes[find(id)]) {
+            if (node.type == ASTNode::Type::Constant) {
+                value = node.value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns true if the class contains the constant value.
+    bool hasConstant(std::size_t id, double value) {
+        double constant;
+        return constantOf(id, constant) && constant == value && std::signbit(constant) == std::signbit(value);
+    }
+
+    // Adds op(left, right) and merges it into class id.
+    void addEquivalent(std::size_t id, ASTNode::Type type, std::size_t left, std::size_t right) {
+        merge(id, add(binary(type, left, right)));
+    }
+
+    // Applies every rule to one e-node of class id.
+    void applyRules(std::size_t id, const ENode &node) {
+        using T = ASTNode::Type;
+        if (node.arity == 1) {
+            if (node.type == T::UnaryMinus) {
+                // -(-x) -> x
+                for (const ENode &inner : std::vector<ENode>(classes[find(node.children[0])])) {
+                    if (inner.type == T::UnaryMinus) {
+                        merge(id, inner.children[0]);
+                    }
+                }
+            } else {
+                // +x -> x
+                merge(id, node.children[0]);
+            }
+            return;
+        }
+        if (node.arity != 2) {
+            return;
+        }
+
+        std::size_t a = find(node.children[0]), b = find(node.children[1]);
+        double x, y;
+        if (constantOf(a, x) && constantOf(b, y) && !(node.type == T::Divide && y == 0)) {
+            // c1 op c2 -> constant
+            auto folded = makeBinary(node.type, std::make_unique<Constant>(x), std::make_unique<Constant>(y));
+            ENode constant{T::Constant};
+            constant.value = folded->evaluate();
+            merge(id, add(constant));
+        }
+
+        switch (node.type) {
+        case T::Add:
+        case T::Multiply: {
+            // a op b -> b op a
+            addEquivalent(id, node.type, b, a);
+            // (a op c) op b -> a op (c op b)
+            for (const ENode &inner : std::vector<ENode>(classes[a])) {
+                if (inner.type == node.type) {
+                    std::size_t tail = add(binary(node.type, inner.children[1], b));
+                    addEquivalent(id, node.type, inner.children[0], tail);
+                }
+            }
+            if (node.type == T::Multiply && (hasConstant(b, 1.0) || hasConstant(a, 1.0))) {
+                // x * 1 -> x
+                merge(id, hasConstant(b, 1.0) ? a : b);
+            }
+            break;
+        }
+        case T::Power:
+            if (hasConstant(b, 1.0)) {
+                // x ^ 1 -> x
+                merge(id, a);
+            } else if (hasConstant(b, 2.0)) {
+                // x ^ 2 -> x * x
+                addEquivalent(id, T::Multiply, a, a);
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (node.type == T::Add || node.type == T::Subtract) {
+            // a * b +/- a * c -> a * (b +/- c)
+            for (const ENode &l : std::vector<ENode>(classes[a])) {
+                if (l.type != T::Multiply) {
+                    continue;
+                }
+                for (const ENode &r : std::vector<ENode>(classes[b])) {
+                    if (r.type == T::Multiply && find(l.children[0]) == find(r.children[0])) {
+                        std::size_t rest = add(binary(node.type, l.children[1], r.children[1]));
+                        addEquivalent(id, T::Multiply, l.children[0], rest);
+                    }
+                }
+            }
+        }
+    }
+
+  public:
+    // Creates a binary e-node.
+    static ENode binary(ASTNode::Type type, std::size_t left, std::size_t right) {
+        ENode node{type};
+        node.arity = 2;
+        node.children[0] = left;
+        node.children[1] = right;
+        return node;
+    }
+
+    // Returns the canonical id of a class.
+    std::size_t find(std::size_t id) {
+        while (parent[id] != id) {
+            parent[id] = parent[parent[id]];
+            id = parent[id];
+        }
+        return id;
+    }
+
+    // Adds an e-node, returning the class that contains it.
+    std::size_t add(const ENode &node) {
+        ENode key = canonical(node);
+        auto it = memo.find(key);
+        if (it != memo.end()) {
+            return find(it->second);
+        }
+        std::size_t id = parent.size();
+        parent.push_back(id);
+        classes.push_back({key});
+        memo.emplace(key, id);
+        ++nodeCount;
+        return id;
+    }
+
+    // Adds a tree, returning the class of its root.
+    std::size_t add(const ASTNode &tree) {
+        ENode node{tree.getType()};
+        if (tree.getType() == ASTNode::Type::Constant) {
+            node.value = static_cast<const Constant &>(tree).getValue();
+        } else if (tree.getType() == ASTNode::Type::Identifier) {
+            const std::string &name = static_cast<const Identifier &>(tree).getIdentifier();
+            auto inserted = symbolIds.emplace(name, symbols.size());
+            if (inserted.second) {
+                symbols.push_back(name);
+            }
+            node.symbol = inserted.first->second;
+        } else if (isUnary(tree.getType())) {
+            node.arity = 1;
+            node.children[0] = add(static_cast<const Unary &>(tree).getInput());
+        } else if (isBinary(tree.getType())) {
+            node.arity = 2;
+            node.children[0] = add(static_cast<const Binary &>(tree).getLeft());
+            node.children[1] = add(static_cast<const Binary &>(tree).getRight());
+        } else {
+            throw std::invalid_argument("EGraph: unsupported node type");
+        }
+        return add(node);
+    }
+
+    // Merges two classes. Returns false if they were already equal.
+    bool merge(std::size_t a, std::size_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) {
+            return false;
+        }
+        if (classes[a].size() < classes[b].size()) {
+            std::swap(a, b);
+        }
+        parent[b] = a;
+        ++mergeCount;
+        classes[a].insert(classes[a].end(), classes[b].begin(), classes[b].end());
+        classes[b].clear();
+        classes[b].shrink_to_fit();
+        return true;
+    }
+
+    // Restores the congruence invariant: e-nodes with equal operator and operand classes share a class.
+    void rebuild() {
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            memo.clear();
+            nodeCount = 0;
+            std::vector<std::pair<std::size_t, std::size_t>> congruent;
+            for (std::size_t id = 0; id < classes.size(); ++id) {
+                if (find(id) != id) {
+                    continue;
+                }
+                std::vector<ENode> unique;
+                for (const ENode &node : classes[id]) {
+                    ENode key = canonical(node);
+                    auto inserted = memo.emplace(key, id);
+                    if (inserted.second) {
+                        unique.push_back(key);
+                    } else if (find(inserted.first->second) != id) {
+                        congruent.emplace_back(inserted.first->second, id);
+                    }
+                }
+                nodeCount += unique.size();
+                classes[id] = std::move(unique);
+            }
+            for (const auto &pair : congruent) {
+                merged = merge(pair.first, pair.second) || merged;
+            }
+        }
+    }
+
+    // Number of e-nodes after the last rebuild.
+    std::size_t size() const { return nodeCount; }
+
+    // Applies the rule set until saturation or until a budget runs out.
+    void saturate(const EGraphOptions &options = EGraphOptions()) {
+        auto deadline = std::chrono::steady_clock::now() + options.timeBudget;
+        for (std::size_t iteration = 0; iteration < options.maxIterations; ++iteration) {
+            std::size_t nodesBefore = nodeCount, mergesBefore = mergeCount, classCount = classes.size();
+            bool exhausted = false;
+            for (std::size_t id = 0; id < classCount && !exhausted; ++id) {
+                if (find(id) != id) {
+                    continue;
+                }
+                for (const ENode &node : std::vector<ENode>(classes[id])) {
+                    applyRules(find(id), node);
+                }
+                exhausted = nodeCount > options.maxNodes || std::chrono::steady_clock::now() > deadline;
+            }
+            rebuild();
+            if (exhausted || (nodeCount == nodesBefore && mergeCount == mergesBefore)) {
+                break;
+            }
+        }
+    }
+
+    // Builds the cheapest tree of a class under the given cost model.
+    std::unique_ptr<const ASTNode> extract(std::size_t root, double (*cost)(ASTNode::Type) = defaultOperationCost) {
+        const double infinity = std::numeric_limits<double>::infinity();
+        std::vector<double> best(classes.size(), infinity);
+        std::vector<ENode> choice(classes.size(), ENode{ASTNode::Type::Constant});
+
+        // Costs only decrease, so iterate until no class improves.
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            for (std::size_t id = 0; id < classes.size(); ++id) {
+                if (find(id) != id) {
+                    continue;
+                }
+                for (const ENode &node : classes[id]) {
+                    double total = cost(node.type);
+                    for (std::size_t i = 0; i < node.arity; ++i) {
+                        total += best[find(node.children[i])];
+                    }
+                    if (total < best[id]) {
+                        best[id] = total;
+                        choice[id] = node;
+                        improved = true;
+                    }
+                }
+            }
+        }
+        return build(find(root), choice);
+    }
+
+  private:
+    // Converts the chosen e-nodes below a class back into a tree.
+    std::unique_ptr<const ASTNode> build(std::size_t id, const std::vector<ENode> &choice) {
+        const ENode &node = choice[find(id)];
+        switch (node.type) {
+        case ASTNode::Type::Constant:
+            return std::make_unique<Constant>(node.value);
+        case ASTNode::Type::Identifier:
+            return std::make_unique<Identifier>(symbols[node.symbol]);
+        default:
+            if (node.arity == 1) {
+                return makeUnary(node.type, build(node.children[0], choice));
+            }
+            return makeBinary(node.type, build(node.children[0], choice), build(node.children[1], choice));
+        }
+    }
+};
+
+// Explores equivalent forms of a tree by equality saturation and returns the cheapest one found within the
+// node and time budgets. The input tree is not modified.
+inline std::unique_ptr<const ASTNode> optimize(const ASTNode &tree, const EGraphOptions &options = EGraphOptions()) {
+    EGraph graph;
+    std::size_t root = graph.add(tree);
+    graph.saturate(options);
+    return graph.extract(root, options.cost);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "transform.hxx"
+#include <vector>
+
+// Returns true if type belongs to the chain family: Add, Subtract and Sum, or Multiply and Product.
+inline bool inChain(ASTNode::Type type, bool additive) {
+    if (additive) {
+        return type == ASTNode::Type::Add || type == ASTNode::Type::Subtract || type == ASTNode::Type::Sum;
+    }
+    return type == ASTNode::Type::Multiply || type == ASTNode::Type::Product;
+}
+
+// Counts the operands of the chain rooted at node.
+inline std::size_t chainLength(const ASTNode &node, bool additive) {
+    if (!inChain(node.getType(), additive)) {
+        return 1;
+    }
+    std::size_t length = 0;
+    forEachChild(node, [&](const ASTNode &child) { length += chainLength(child, additive); });
+    return length;
+}
+
+inline std::unique_ptr<const ASTNode> flattenChains(std::unique_ptr<const ASTNode> node);
+
+// Moves the operands of the chain rooted at node into operands, left to right, flattening each operand.
+// Subtracted operands of an additive chain are wrapped in UnaryMinus, which is exact.
+inline void collectOperands(std::unique_ptr<const ASTNode> node, bool additive, bool negate,
+                            std::vector<std::unique_ptr<const ASTNode>> &operands) {
+    ASTNode::Type type = node->getType();
+    if (!inChain(type, additive)) {
+        std::unique_ptr<const ASTNode> operand = flattenChains(std::move(node));
+        if (negate) {
+            operand = operand->getType() == ASTNode::Type::UnaryMinus ? mutableUnary(operand).releaseInput()
+                                                                     : std::make_unique<UnaryMinus>(std::move(operand));
+        }
+        operands.push_back(std::move(operand));
+    } else if (isNary(type)) {
+        for (auto &operand : mutableNary(node).releaseOperands()) {
+            collectOperands(std::move(operand), additive, negate, operands);
+        }
+    } else {
+        Binary &binary = mutableBinary(node);
+        collectOperands(binary.releaseLeft(), additive, negate, operands);
+        collectOperands(binary.releaseRight(), additive, type == ASTNode::Type::Subtract ? !negate : negate,
+                        operands);
+    }
+}
+
+// Collapses chains of three or more Add/Subtract operands into Sum nodes and chains of Multiply into Product
+// nodes, so a 50-term sum becomes one node with a contiguous operand array instead of 49 nested Add nodes.
+// Operand order is kept, so a left-deep chain evaluates to exactly the same result; other shapes are
+// reassociated into left-to-right order.
+inline std::unique_ptr<const ASTNode> flattenChains(std::unique_ptr<const ASTNode> node) {
+    for (bool additive : {true, false}) {
+        if (inChain(node->getType(), additive) && chainLength(*node, additive) >= 3) {
+            std::vector<std::unique_ptr<const ASTNode>> operands;
+            collectOperands(std::move(node), additive, false, operands);
+            if (additive) {
+                return std::make_unique<Sum>(std::move(operands));
+            }
+            return std::make_unique<Product>(std::move(operands));
+        }
+    }
+    rewriteChildren(node, [](std::unique_ptr<const ASTNode> child) { return flattenChains(std::move(child)); });
+    return node;
+}
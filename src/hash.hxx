@@ -0,0 +1,88 @@
+#pragma once
+
+#include "transform.hxx"
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Combines a value into a running 64-bit hash.
+inline std::uint64_t hashCombine(std::uint64_t hash, std::uint64_t value) {
+    value *= 0x9e3779b97f4a7c15ULL;
+    value ^= value >> 32;
+    return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+}
+
+// 64-bit FNV-1a hash of a name. Unlike std::hash it is the same in every build and process, so structural
+// hashes can be stored. Passing a previous result as hash continues the hash over more bytes.
+inline std::uint64_t hashName(std::string_view name, std::uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (char c : name) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Bits of a double for hashing. Polynomial coefficients compare with ==, so -0 hashes like +0 there.
+inline std::uint64_t hashDouble(double value, bool signedZero) {
+    if (!signedZero && value == 0) {
+        value = 0.0;
+    }
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+// Structural hash of a tree: node types, constants, identifier names and operand order. Trees that sameTree()
+// considers equal hash equally. Each node caches its hash, so after the first call it is O(1), and setters
+// that replace or release an operand clear the cache of the node they modify and of all its ancestors.
+inline std::uint64_t structuralHash(const ASTNode &node) {
+    std::uint64_t hash = node.getCachedHash();
+    if (hash != 0) {
+        return hash;
+    }
+    ASTNode::Type type = node.getType();
+    hash = hashCombine(0x2545f4914f6cdd1dULL, static_cast<std::uint64_t>(type));
+    if (type == ASTNode::Type::Constant) {
+        hash = hashCombine(hash, hashDouble(static_cast<const Constant &>(node).getValue(), true));
+    } else if (type == ASTNode::Type::Identifier) {
+        hash = hashCombine(hash, hashName(static_cast<const Identifier &>(node).getIdentifier()));
+    } else {
+        if (type == ASTNode::Type::Polynomial) {
+            for (double coefficient : static_cast<const Polynomial &>(node).getCoefficients()) {
+                hash = hashCombine(hash, hashDouble(coefficient, false));
+            }
+        }
+        forEachChild(node, [&](const ASTNode &child) { hash = hashCombine(hash, structuralHash(child)); });
+    }
+    hash += hash == 0; // Zero marks "not computed".
+    node.setCachedHash(hash);
+    return hash;
+}
+
+// Returns true if both trees have the same structure. Different hashes reject most pairs in O(1).
+inline bool structurallyEqual(const ASTNode &a, const ASTNode &b) {
+    return &a == &b || (structuralHash(a) == structuralHash(b) && sameTree(a, b));
+}
+
+// Orders the operands of commutative nodes (Add, Multiply and the two factors of MultiplyAdd) by structural
+// hash, so that a + b and b + a become the same tree and share cache entries. Swapping these operands is exact
+// in IEEE arithmetic, so the canonical tree evaluates to the same value.
+inline std::unique_ptr<const ASTNode> canonicalize(std::unique_ptr<const ASTNode> node) {
+    rewriteChildren(node, [](std::unique_ptr<const ASTNode> child) { return canonicalize(std::move(child)); });
+    ASTNode::Type type = node->getType();
+    if (type == ASTNode::Type::Add || type == ASTNode::Type::Multiply) {
+        Binary &binary = mutableBinary(node);
+        if (structuralHash(binary.getRight()) < structuralHash(binary.getLeft())) {
+            std::unique_ptr<const ASTNode> left = binary.releaseLeft();
+            binary.resetLeft(binary.releaseRight());
+            binary.resetRight(std::move(left));
+        }
+    } else if (type == ASTNode::Type::MultiplyAdd) {
+        MultiplyAdd &fma = mutableMultiplyAdd(node);
+        if (structuralHash(fma.getMultiplier()) < structuralHash(fma.getMultiplicand())) {
+            std::unique_ptr<const ASTNode> multiplicand = fma.releaseMultiplicand();
+            fma.resetMultiplicand(fma.releaseMultiplier());
+            fma.resetMultiplier(std::move(multiplicand));
+        }
+    }
+    return node;
+}
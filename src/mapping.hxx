@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. An empty file maps to a null pointer and size zero.
+class FileMapping {
+    const char *mappedData = nullptr;
+    std::size_t mappedSize = 0;
+
+  public:
+    explicit FileMapping(const std::string &path) {
+        int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        struct stat status;
+        if (fstat(descriptor, &status) != 0) {
+            int error = errno;
+            close(descriptor);
+            throw std::system_error(error, std::generic_category(), "fstat " + path);
+        }
+        mappedSize = static_cast<std::size_t>(status.st_size);
+        if (mappedSize > 0) {
+            void *address = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (address == MAP_FAILED) {
+                int error = errno;
+                close(descriptor);
+                throw std::system_error(error, std::generic_category(), "mmap " + path);
+            }
+            mappedData = static_cast<const char *>(address);
+        }
+        close(descriptor); // The mapping keeps the file open.
+    }
+
+    FileMapping(const FileMapping &) = delete;
+    FileMapping &operator=(const FileMapping &) = delete;
+
+    ~FileMapping() {
+        if (mappedData != nullptr) {
+            munmap(const_cast<char *>(mappedData), mappedSize);
+        }
+    }
+
+    // Start of the file contents, page-aligned.
+    const char *data() const { return mappedData; }
+
+    // Size of the file in bytes.
+    std::size_t size() const { return mappedSize; }
+
+    // Tells the kernel the mapping will be read front to back.
+    void adviseSequential() const {
+        if (mappedData != nullptr) {
+            madvise(const_cast<char *>(mappedData), mappedSize, MADV_SEQUENTIAL);
+        }
+    }
+};
+
+// Writes size bytes to path under a temporary name and renames the file into place, so a concurrent reader
+// sees either the old contents or the complete new ones, never a partial file.
+inline void writeFileReplacing(const std::string &path, const char *data, std::size_t size) {
+    static std::atomic<unsigned> sequence{0};
+    std::string temporary = path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(sequence++);
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::system_error(errno, std::generic_category(), "fopen " + temporary);
+    }
+    bool written = std::fwrite(data, 1, size, file) == size;
+    written = std::fclose(file) == 0 && written;
+    if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("cannot write " + path);
+    }
+}
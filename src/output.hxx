@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+// Buffered writer of evaluation results to a file descriptor.
+//
+// In text format every value is formatted with std::to_chars (the shortest text that reads back to the same
+// double, independent of the locale) followed by a newline. In binary format values are written as raw doubles
+// in host byte order (little-endian on x86-64 and AArch64), 8 bytes each. Output collects in a large buffer
+// that is handed to write(2) only when full, on flush() and on destruction, so the cost per value is the
+// formatting alone.
+class ResultWriter {
+  public:
+    enum class Format { Text, Binary };
+
+  private:
+    static constexpr std::size_t maxTextBytes = 32; // Longest formatted double plus newline.
+
+    int descriptor;
+    Format format;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+
+  public:
+    // Writes to descriptor, which stays owned by the caller, through a buffer of bufferBytes.
+    explicit ResultWriter(int descriptor, Format format = Format::Text, std::size_t bufferBytes = 1 << 20)
+        : descriptor(descriptor), format(format), buffer(std::max<std::size_t>(bufferBytes, maxTextBytes)) {}
+
+    ResultWriter(const ResultWriter &) = delete;
+    ResultWriter &operator=(const ResultWriter &) = delete;
+
+    // Flushes what is left; errors at this point are ignored, so call flush() to see them.
+    ~ResultWriter() {
+        try {
+            flush();
+        } catch (const std::system_error &) {
+        }
+    }
+
+    // Appends one value.
+    void write(double value) {
+        if (buffer.size() - used < maxTextBytes) {
+            flush();
+        }
+        if (format == Format::Binary) {
+            std::memcpy(buffer.data() + used, &value, sizeof(value));
+            used += sizeof(value);
+            return;
+        }
+        char *end = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value).ptr;
+        *end++ = '\n';
+        used = static_cast<std::size_t>(end - buffer.data());
+    }
+
+    // Appends count values.
+    void write(const double *values, std::size_t count) {
+        if (format == Format::Binary) {
+            for (std::size_t done = 0; done < count;) {
+                if (buffer.size() - used < sizeof(double)) {
+                    flush();
+                }
+                std::size_t n = std::min(count - done, (buffer.size() - used) / sizeof(double));
+                std::memcpy(buffer.data() + used, values + done, n * sizeof(double));
+                used += n * sizeof(double);
+                done += n;
+            }
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            write(values[i]);
+        }
+    }
+
+    // Writes the buffered output; throws std::system_error if the descriptor rejects it.
+    void flush() {
+        for (std::size_t done = 0; done < used;) {
+            ssize_t written = ::write(descriptor, buffer.data() + done, used - done);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                used = 0;
+                throw std::system_error(errno, std::generic_category(), "write");
+            }
+            done += static_cast<std::size_t>(written);
+        }
+        used = 0;
+    }
+};
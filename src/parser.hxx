@@ -0,0 +1,130 @@
+#pragma once
+
+#include "ast.hxx"
+#include <cctype>
+#include <charconv>
+#include <string>
+#include <string_view>
+
+// Recursive-descent parser for expression text.
+//
+//     expression := term (('+' | '-') term)*
+//     term       := unary (('*' | '/') unary)*
+//     unary      := ('+' | '-') unary | power
+//     power      := primary ('^' unary)?          (right-associative; -x^2 is -(x^2))
+//     primary    := number | identifier | '(' expression ')'
+//
+// Identifiers are [A-Za-z_][A-Za-z0-9_]*. Errors throw std::invalid_argument with the offending position.
+class Parser {
+    std::string_view text;
+    std::size_t position = 0;
+
+    [[noreturn]] void fail(const std::string &message) const {
+        throw std::invalid_argument("parse error at position " + std::to_string(position) + ": " + message);
+    }
+
+    void skipSpace() {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+            ++position;
+        }
+    }
+
+    // Consumes c if it is the next non-space character.
+    bool accept(char c) {
+        skipSpace();
+        if (position < text.size() && text[position] == c) {
+            ++position;
+            return true;
+        }
+        return false;
+    }
+
+    std::unique_ptr<const ASTNode> expression() {
+        std::unique_ptr<const ASTNode> node = term();
+        for (;;) {
+            if (accept('+')) {
+                node = std::make_unique<Add>(std::move(node), term());
+            } else if (accept('-')) {
+                node = std::make_unique<Subtract>(std::move(node), term());
+            } else {
+                return node;
+            }
+        }
+    }
+
+    std::unique_ptr<const ASTNode> term() {
+        std::unique_ptr<const ASTNode> node = unary();
+        for (;;) {
+            if (accept('*')) {
+                node = std::make_unique<Multiply>(std::move(node), unary());
+            } else if (accept('/')) {
+                node = std::make_unique<Divide>(std::move(node), unary());
+            } else {
+                return node;
+            }
+        }
+    }
+
+    std::unique_ptr<const ASTNode> unary() {
+        if (accept('+')) {
+            return std::make_unique<UnaryPlus>(unary());
+        }
+        if (accept('-')) {
+            return std::make_unique<UnaryMinus>(unary());
+        }
+        std::unique_ptr<const ASTNode> base = primary();
+        if (accept('^')) {
+            return std::make_unique<Power>(std::move(base), unary());
+        }
+        return base;
+    }
+
+    std::unique_ptr<const ASTNode> primary() {
+        skipSpace();
+        if (position == text.size()) {
+            fail("unexpected end of expression");
+        }
+        char c = text[position];
+        if (accept('(')) {
+            std::unique_ptr<const ASTNode> node = expression();
+            if (!accept(')')) {
+                fail("expected ')'");
+            }
+            return node;
+        }
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            std::size_t begin = position;
+            while (position < text.size() &&
+                   (std::isalnum(static_cast<unsigned char>(text[position])) || text[position] == '_')) {
+                ++position;
+            }
+            return std::make_unique<Identifier>(text.substr(begin, position - begin));
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            double value = 0.0;
+            auto result = std::from_chars(text.data() + position, text.data() + text.size(), value);
+            if (result.ec != std::errc()) {
+                fail("malformed number");
+            }
+            position = static_cast<std::size_t>(result.ptr - text.data());
+            return std::make_unique<Constant>(value);
+        }
+        fail(std::string("unexpected '") + c + "'");
+    }
+
+  public:
+    explicit Parser(std::string_view text) : text(text) {}
+
+    // Parses the whole text as one expression.
+    std::unique_ptr<const ASTNode> parse() {
+        std::unique_ptr<const ASTNode> node = expression();
+        skipSpace();
+        if (position != text.size()) {
+            fail(std::string("unexpected '") + text[position] + "'");
+        }
+        return node;
+    }
+};
+
+// Parses text into an expression tree; throws std::invalid_argument on malformed input.
+inline std::unique_ptr<const ASTNode> parseExpression(std::string_view text) { return Parser(text).parse(); }
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "batch.hxx"
+#include "csv.hxx"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer, single-consumer queue of trivially copyable values (chunk pointers, typically).
+//
+// The producer owns tail and the consumer owns head; each publishes its index with a release store that the
+// other reads with an acquire load, so no lock or read-modify-write is needed. A full queue makes push() wait,
+// which is what bounds the memory of a pipeline. close() ends the stream: pop() drains what is left and then
+// returns false, and push() on a closed, full queue gives up instead of waiting.
+template <typename T> class SpscQueue {
+    std::vector<T> slots;
+    std::size_t mask;
+    alignas(64) std::atomic<std::size_t> head{0}; // Next slot to pop.
+    alignas(64) std::atomic<std::size_t> tail{0}; // Next slot to push.
+    alignas(64) std::atomic<bool> closed{false};
+
+  public:
+    // Creates a queue holding at least capacity values.
+    explicit SpscQueue(std::size_t capacity) {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    // Pushes value if there is room. Producer only.
+    bool tryPush(T value) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots.size()) {
+            return false;
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pops into value if the queue is not empty. Consumer only.
+    bool tryPop(T &value) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pushes value, waiting while the queue is full. Returns false if the queue was closed meanwhile.
+    bool push(T value) {
+        while (!tryPush(value)) {
+            if (closed.load(std::memory_order_acquire)) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // Pops into value, waiting while the queue is empty. Returns false once the queue is closed and drained.
+    bool pop(T &value) {
+        while (!tryPop(value)) {
+            if (closed.load(std::memory_order_acquire)) {
+                return tryPop(value);
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // Ends the stream; either side may call it.
+    void close() { closed.store(true, std::memory_order_release); }
+};
+
+// Evaluates tree over every row of reader (a CsvReader or BlockCsvReader) in a three-stage pipeline, calling
+// sink(results, rows) for each chunk of rows in input order, on the calling thread.
+//
+// A reader thread parses chunks of rowsPerChunk rows; `workers` threads evaluate them, each with its own
+// BatchEvaluator; the calling thread hands the results to sink. Chunk i goes to worker i % workers and comes back
+// through that worker's output queue, so the writer restores input order by visiting the workers round-robin.
+// Chunks are recycled through a free queue back to the reader, so at most 2 * workers + 2 chunks exist at once
+// and a slow stage stalls the ones before it instead of letting memory grow. An exception from the reader, a
+// worker or the sink stops every stage, without parsing or evaluating the chunks still queued, and is rethrown
+// once every thread has been joined.
+template <typename Reader, typename Sink>
+void evaluatePipelined(Reader &reader, const ASTNode &tree, Sink sink, std::size_t workers = 2,
+                       std::size_t rowsPerChunk = 1 << 16) {
+    struct Chunk {
+        std::size_t rows = 0;
+        std::vector<std::vector<double>> columns;
+        std::vector<double *> targets;
+        std::vector<double> results;
+    };
+
+    workers = std::max<std::size_t>(1, workers);
+    const std::vector<std::string> &names = reader.getNames();
+    std::size_t chunkCount = 2 * workers + 2;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    SpscQueue<Chunk *> free(chunkCount);
+    std::vector<std::unique_ptr<SpscQueue<Chunk *>>> toWorker, toWriter;
+    for (std::size_t i = 0; i < chunkCount; ++i) {
+        auto chunk = std::make_unique<Chunk>();
+        chunk->columns.resize(names.size());
+        for (std::size_t c = 0; c < names.size(); ++c) {
+            chunk->columns[c].resize(reader.isSelected(c) ? rowsPerChunk : 0);
+            chunk->targets.push_back(chunk->columns[c].data());
+        }
+        chunk->results.resize(rowsPerChunk);
+        free.tryPush(chunk.get());
+        chunks.push_back(std::move(chunk));
+    }
+    for (std::size_t w = 0; w < workers; ++w) {
+        toWorker.push_back(std::make_unique<SpscQueue<Chunk *>>(chunkCount));
+        toWriter.push_back(std::make_unique<SpscQueue<Chunk *>>(chunkCount));
+    }
+    std::atomic<bool> stopped{false}; // Checked by the reader and workers before each chunk.
+    auto closeAll = [&] {
+        stopped.store(true, std::memory_order_release);
+        free.close();
+        for (std::size_t w = 0; w < workers; ++w) {
+            toWorker[w]->close();
+            toWriter[w]->close();
+        }
+    };
+
+    std::exception_ptr readerError;
+    std::thread readerThread([&] {
+        try {
+            Chunk *chunk;
+            for (std::size_t i = 0; free.pop(chunk) && !stopped.load(std::memory_order_acquire); ++i) {
+                chunk->rows = reader.read(rowsPerChunk, chunk->targets.data());
+                if (chunk->rows == 0 || !toWorker[i % workers]->push(chunk)) {
+                    break;
+                }
+            }
+        } catch (...) {
+            readerError = std::current_exception();
+            stopped.store(true, std::memory_order_release);
+            free.close();
+        }
+        for (std::size_t w = 0; w < workers; ++w) {
+            toWorker[w]->close();
+        }
+    });
+    std::vector<std::exception_ptr> workerErrors(workers);
+    std::vector<std::thread> workerThreads;
+    for (std::size_t w = 0; w < workers; ++w) {
+        workerThreads.emplace_back([&, w] {
+            try {
+                BatchEvaluator evaluator;
+                Chunk *chunk;
+                while (toWorker[w]->pop(chunk) && !stopped.load(std::memory_order_acquire)) {
+                    for (std::size_t c = 0; c < names.size(); ++c) {
+                        if (reader.isSelected(c)) {
+                            evaluator.bindColumn(names[c], chunk->columns[c].data());
+                        }
+                    }
+                    evaluator.evaluate(tree, chunk->results.data(), chunk->rows);
+                    if (!toWriter[w]->push(chunk)) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                workerErrors[w] = std::current_exception();
+                closeAll();
+            }
+            toWriter[w]->close();
+        });
+    }
+
+    std::exception_ptr sinkError;
+    try {
+        Chunk *chunk;
+        for (std::size_t i = 0; toWriter[i % workers]->pop(chunk); ++i) {
+            sink(static_cast<const double *>(chunk->results.data()), chunk->rows);
+            free.push(chunk);
+        }
+    } catch (...) {
+        sinkError = std::current_exception();
+        stopped.store(true, std::memory_order_release);
+    }
+    // Wake every stage in case the writer stopped early; after a normal end this changes nothing.
+    closeAll();
+    readerThread.join();
+    for (std::thread &thread : workerThreads) {
+        thread.join();
+    }
+    if (readerError) {
+        std::rethrow_exception(readerError);
+    }
+    for (const std::exception_ptr &error : workerErrors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    if (sinkError) {
+        std::rethrow_exception(sinkError);
+    }
+}
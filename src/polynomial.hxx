@@ -0,0 +1,103 @@
+#pragma once
+
+#include "transform.hxx"
+#include <string>
+#include <vector>
+
+// Options for polynomial detection.
+struct PolynomialOptions {
+    std::size_t maxDegree = 32; // Powers above this degree are left to std::pow.
+    std::size_t minDegree = 2;  // Smaller polynomials are cheaper as written.
+};
+
+// Accumulates sign * node into coefficients if node is a polynomial in a single identifier. The identifier is
+// taken from the first monomial seen and stored in variable. Returns false if node is not such a polynomial.
+inline bool collectPolynomial(const ASTNode &node, double sign, std::string &variable,
+                              std::vector<double> &coefficients, const PolynomialOptions &options) {
+    // Adds sign * scale * variable^degree.
+    auto addMonomial = [&](const Identifier &identifier, std::size_t degree, double scale) {
+        if (degree > options.maxDegree || (!variable.empty() && variable != identifier.getIdentifier())) {
+            return false;
+        }
+        variable = identifier.getIdentifier();
+        if (coefficients.size() <= degree) {
+            coefficients.resize(degree + 1, 0.0);
+        }
+        coefficients[degree] += sign * scale;
+        return true;
+    };
+    // Recognizes variable and variable^k with k a non-negative integer constant.
+    auto monomial = [&](const ASTNode &term, double scale) {
+        if (term.getType() == ASTNode::Type::Identifier) {
+            return addMonomial(static_cast<const Identifier &>(term), 1, scale);
+        }
+        if (term.getType() != ASTNode::Type::Power) {
+            return false;
+        }
+        const auto &power = static_cast<const Power &>(term);
+        if (power.getLeft().getType() != ASTNode::Type::Identifier ||
+            power.getRight().getType() != ASTNode::Type::Constant) {
+            return false;
+        }
+        double exponent = static_cast<const Constant &>(power.getRight()).getValue();
+        if (!(exponent >= 0) || exponent != std::floor(exponent) || exponent > options.maxDegree) {
+            return false;
+        }
+        return addMonomial(static_cast<const Identifier &>(power.getLeft()), static_cast<std::size_t>(exponent),
+                           scale);
+    };
+
+    switch (node.getType()) {
+    case ASTNode::Type::Constant:
+        if (coefficients.empty()) {
+            coefficients.push_back(0.0);
+        }
+        coefficients[0] += sign * static_cast<const Constant &>(node).getValue();
+        return true;
+    case ASTNode::Type::UnaryPlus:
+        return collectPolynomial(static_cast<const Unary &>(node).getInput(), sign, variable, coefficients, options);
+    case ASTNode::Type::UnaryMinus:
+        return collectPolynomial(static_cast<const Unary &>(node).getInput(), -sign, variable, coefficients, options);
+    case ASTNode::Type::Add:
+    case ASTNode::Type::Subtract: {
+        const auto &binary = static_cast<const Binary &>(node);
+        double rightSign = node.getType() == ASTNode::Type::Add ? sign : -sign;
+        return collectPolynomial(binary.getLeft(), sign, variable, coefficients, options) &&
+               collectPolynomial(binary.getRight(), rightSign, variable, coefficients, options);
+    }
+    case ASTNode::Type::Multiply: {
+        // c * monomial or monomial * c
+        const auto &binary = static_cast<const Binary &>(node);
+        if (binary.getLeft().getType() == ASTNode::Type::Constant) {
+            return monomial(binary.getRight(), static_cast<const Constant &>(binary.getLeft()).getValue());
+        }
+        if (binary.getRight().getType() == ASTNode::Type::Constant) {
+            return monomial(binary.getLeft(), static_cast<const Constant &>(binary.getRight()).getValue());
+        }
+        return false;
+    }
+    default:
+        return monomial(node, 1.0);
+    }
+}
+
+// Rewrites polynomial subtrees in one identifier, such as 3 * x^3 - x^2 + 2 * x + 1, into Polynomial nodes
+// evaluated in Horner form. The largest matching subtree is replaced; other subtrees are searched recursively.
+// Horner form rounds differently from the sum of powers, so the pass is opt-in.
+inline std::unique_ptr<const ASTNode> detectPolynomials(std::unique_ptr<const ASTNode> node,
+                                                        const PolynomialOptions &options = PolynomialOptions()) {
+    ASTNode::Type type = node->getType();
+    if (isBinary(type) || type == ASTNode::Type::UnaryMinus) {
+        std::string variable;
+        std::vector<double> coefficients;
+        if (collectPolynomial(*node, 1.0, variable, coefficients, options) && !variable.empty() &&
+            coefficients.size() > options.minDegree) {
+            return std::make_unique<Polynomial>(std::make_unique<Identifier>(variable), std::move(coefficients));
+        }
+    }
+
+    rewriteChildren(node, [&](std::unique_ptr<const ASTNode> child) {
+        return detectPolynomials(std::move(child), options);
+    });
+    return node;
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include "cache.hxx"
+#include "parser.hxx"
+#include "simplify.hxx"
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+// Cache from expression text to its parsed and optimized tree.
+//
+// Lookups take no lock. Entries are immutable and live in a fixed-size open-addressing table of atomic
+// pointers keyed by the FNV-1a hash of the text; a reader probes it, marks the entry referenced for CLOCK
+// eviction, and uses the tree. Compiling a new text and evicting old ones is done by one writer at a time under
+// a mutex. An evicted entry is unlinked first and freed only after every reader that could still see it has
+// left: readers announce themselves by incrementing one of two counters, chosen by the parity of a global
+// epoch, in a per-thread stripe; the writer flips the epoch and waits for the old parity to drain before
+// freeing (a grace period, as in RCU).
+//
+// Memory is bounded by an approximate byte budget covering the text and the tree of every entry.
+class ProgramCache {
+  public:
+    // Turns expression text into the tree to cache. The default parses and simplifies.
+    using Compiler = std::function<std::unique_ptr<const ASTNode>(std::string_view)>;
+
+  private:
+    struct Entry {
+        std::uint64_t hash;
+        std::string text;
+        std::unique_ptr<const ASTNode> tree;
+        std::size_t bytes;
+        mutable std::atomic<bool> referenced{true};
+    };
+
+    struct Table {
+        std::size_t mask;
+        std::unique_ptr<std::atomic<Entry *>[]> slots;
+
+        explicit Table(std::size_t size) : mask(size - 1), slots(new std::atomic<Entry *>[size]) {
+            for (std::size_t i = 0; i < size; ++i) {
+                slots[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct alignas(64) Stripe {
+        std::atomic<std::uint64_t> readers[2] = {{0}, {0}};
+    };
+
+    static constexpr std::size_t stripeCount = 64;
+    static constexpr std::size_t nodeBytes = 64; // Approximate size of one tree node.
+
+    // A tombstone keeps probe sequences intact where an entry was evicted.
+    static Entry *tombstone() {
+        static Entry marker;
+        return &marker;
+    }
+
+    Compiler compile;
+    std::size_t maxBytes;
+    std::atomic<Table *> table;
+    std::atomic<std::uint64_t> epoch{0};
+    Stripe stripes[stripeCount];
+    std::atomic<std::uint64_t> hits{0}, misses{0}, evictions{0};
+
+    // Owned by the writer, under writerMutex.
+    std::mutex writerMutex;
+    std::unique_ptr<Table> current;
+    std::size_t bytes = 0, live = 0, tombstones = 0, hand = 0;
+
+    static std::size_t countNodes(const ASTNode &node) {
+        std::size_t count = 1;
+        forEachChild(node, [&](const ASTNode &child) { count += countNodes(child); });
+        return count;
+    }
+
+    static Stripe &stripeOf(Stripe *stripes) {
+        static thread_local std::size_t index =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) % stripeCount;
+        return stripes[index];
+    }
+
+    // Read-side critical section: entries seen inside it stay allocated until it ends.
+    class ReadGuard {
+        std::atomic<std::uint64_t> *counter;
+
+      public:
+        explicit ReadGuard(ProgramCache &cache) {
+            Stripe &stripe = stripeOf(cache.stripes);
+            for (;;) {
+                std::uint64_t e = cache.epoch.load();
+                counter = &stripe.readers[e & 1];
+                counter->fetch_add(1);
+                if (cache.epoch.load() == e) {
+                    return;
+                }
+                counter->fetch_sub(1); // A writer flipped the epoch meanwhile; announce under the new parity.
+            }
+        }
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard &operator=(const ReadGuard &) = delete;
+        ~ReadGuard() { counter->fetch_sub(1, std::memory_order_release); }
+    };
+
+    // Waits until no reader can still see entries unlinked before the call. Caller holds writerMutex.
+    void synchronize() {
+        std::uint64_t old = epoch.fetch_add(1);
+        for (Stripe &stripe : stripes) {
+            while (stripe.readers[old & 1].load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    const Entry *find(std::string_view text, std::uint64_t hash) const {
+        const Table *t = table.load(std::memory_order_acquire);
+        for (std::size_t i = hash & t->mask, probes = 0; probes <= t->mask; i = (i + 1) & t->mask, ++probes) {
+            const Entry *entry = t->slots[i].load(std::memory_order_acquire);
+            if (entry == nullptr) {
+                return nullptr;
+            }
+            if (entry != tombstone() && entry->hash == hash && entry->text == text) {
+                return entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // Unlinks the CLOCK victim into retired. Caller holds writerMutex.
+    void evictOne(std::vector<std::unique_ptr<Entry>> &retired) {
+        for (;;) {
+            hand = (hand + 1) & current->mask;
+            Entry *entry = current->slots[hand].load(std::memory_order_relaxed);
+            if (entry == nullptr || entry == tombstone()) {
+                continue;
+            }
+            if (entry->referenced.exchange(false, std::memory_order_relaxed)) {
+                continue;
+            }
+            current->slots[hand].store(tombstone(), std::memory_order_release);
+            bytes -= entry->bytes;
+            --live;
+            ++tombstones;
+            evictions.fetch_add(1, std::memory_order_relaxed);
+            retired.emplace_back(entry);
+            return;
+        }
+    }
+
+    // Moves the live entries into a fresh table, dropping tombstones. Caller holds writerMutex.
+    std::unique_ptr<Table> rebuild() {
+        auto fresh = std::make_unique<Table>(current->mask + 1);
+        for (std::size_t i = 0; i <= current->mask; ++i) {
+            Entry *entry = current->slots[i].load(std::memory_order_relaxed);
+            if (entry != nullptr && entry != tombstone()) {
+                std::size_t j = entry->hash & fresh->mask;
+                while (fresh->slots[j].load(std::memory_order_relaxed) != nullptr) {
+                    j = (j + 1) & fresh->mask;
+                }
+                fresh->slots[j].store(entry, std::memory_order_relaxed);
+            }
+        }
+        table.store(fresh.get(), std::memory_order_release);
+        tombstones = 0;
+        std::unique_ptr<Table> old = std::move(current);
+        current = std::move(fresh);
+        return old;
+    }
+
+    // Publishes a compiled entry, evicting as needed. Returns false if another thread inserted it first.
+    bool insert(std::unique_ptr<Entry> entry) {
+        std::vector<std::unique_ptr<Entry>> retired;
+        std::unique_ptr<Table> oldTable;
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            if (find(entry->text, entry->hash) != nullptr) {
+                return false;
+            }
+            // Keep at most half of the slots live, and the byte budget (always admitting one entry).
+            while (live > 0 && (bytes + entry->bytes > maxBytes || 2 * (live + 1) > current->mask + 1)) {
+                evictOne(retired);
+            }
+            if (4 * tombstones > current->mask + 1) {
+                oldTable = rebuild();
+            }
+            std::size_t i = entry->hash & current->mask;
+            for (;;) {
+                Entry *slot = current->slots[i].load(std::memory_order_relaxed);
+                if (slot == nullptr || slot == tombstone()) {
+                    tombstones -= slot != nullptr;
+                    break;
+                }
+                i = (i + 1) & current->mask;
+            }
+            bytes += entry->bytes;
+            ++live;
+            current->slots[i].store(entry.release(), std::memory_order_release);
+            if (!retired.empty() || oldTable) {
+                synchronize();
+            }
+        }
+        return true;
+    }
+
+  public:
+    // Creates a cache bounded to about maxBytes of text and trees, with room for slotCount / 2 entries.
+    explicit ProgramCache(std::size_t maxBytes, std::size_t slotCount = 4096,
+                          Compiler compile = [](std::string_view text) { return simplify(parseExpression(text)); })
+        : compile(std::move(compile)), maxBytes(maxBytes) {
+        std::size_t size = 4;
+        while (size < slotCount) {
+            size *= 2;
+        }
+        current = std::make_unique<Table>(size);
+        table.store(current.get(), std::memory_order_release);
+    }
+
+    ProgramCache(const ProgramCache &) = delete;
+    ProgramCache &operator=(const ProgramCache &) = delete;
+
+    ~ProgramCache() {
+        for (std::size_t i = 0; i <= current->mask; ++i) {
+            Entry *entry = current->slots[i].load(std::memory_order_relaxed);
+            if (entry != nullptr && entry != tombstone()) {
+                delete entry;
+            }
+        }
+    }
+
+    // Runs use(const ASTNode &) on the compiled tree for text, compiling it on a miss, and returns its result.
+    // Compile errors propagate as exceptions. The tree is only valid during the call, and use must not call
+    // back into this cache.
+    template <typename Use>
+    auto use(std::string_view text, Use use) -> decltype(use(std::declval<const ASTNode &>())) {
+        std::uint64_t hash = hashName(text);
+        {
+            ReadGuard guard(*this);
+            if (const Entry *entry = find(text, hash)) {
+                entry->referenced.store(true, std::memory_order_relaxed);
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return use(*entry->tree);
+            }
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        auto entry = std::make_unique<Entry>();
+        entry->hash = hash;
+        entry->text = std::string(text);
+        entry->tree = compile(text);
+        entry->bytes = sizeof(Entry) + text.size() + nodeBytes * countNodes(*entry->tree);
+        // Use the tree before publishing it: once published it may be evicted at any time.
+        auto result = use(*entry->tree);
+        insert(std::move(entry));
+        return result;
+    }
+
+    // Evaluates the compiled tree for text.
+    double evaluate(std::string_view text) {
+        return use(text, [](const ASTNode &tree) { return tree.evaluate(); });
+    }
+
+    // Current counters, number of cached programs and approximate bytes held.
+    CacheStats getStats() {
+        CacheStats stats;
+        stats.hits = hits.load(std::memory_order_relaxed);
+        stats.misses = misses.load(std::memory_order_relaxed);
+        stats.evictions = evictions.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(writerMutex);
+        stats.size = live;
+        stats.bytes = bytes;
+        return stats;
+    }
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "transform.hxx"
+#include <vector>
+
+// Collects the operands of a maximal chain of nodes of the given type, left to right.
+inline void collectChain(std::unique_ptr<const ASTNode> node, ASTNode::Type type,
+                         std::vector<std::unique_ptr<const ASTNode>> &operands) {
+    if (node->getType() != type) {
+        operands.push_back(std::move(node));
+        return;
+    }
+    Binary &binary = mutableBinary(node);
+    collectChain(binary.releaseLeft(), type, operands);
+    collectChain(binary.releaseRight(), type, operands);
+}
+
+// Builds a balanced tree of the given type over operands[begin, end).
+inline std::unique_ptr<const ASTNode> buildBalanced(ASTNode::Type type,
+                                                    std::vector<std::unique_ptr<const ASTNode>> &operands,
+                                                    std::size_t begin, std::size_t end) {
+    if (end - begin == 1) {
+        return std::move(operands[begin]);
+    }
+    std::size_t middle = begin + (end - begin) / 2;
+    std::unique_ptr<const ASTNode> left = buildBalanced(type, operands, begin, middle);
+    std::unique_ptr<const ASTNode> right = buildBalanced(type, operands, middle, end);
+    return makeBinary(type, std::move(left), std::move(right));
+}
+
+// Rebalances chains of Add and Multiply nodes.
+//
+// A left-deep chain such as ((a + b) + c) + d is one long dependency chain; the balanced form
+// (a + b) + (c + d) has depth log2(N), so independent partial sums can execute in parallel. Floating-point
+// addition and multiplication are not associative, so this is a fast-math pass and only runs when called.
+inline std::unique_ptr<const ASTNode> reassociate(std::unique_ptr<const ASTNode> node) {
+    ASTNode::Type type = node->getType();
+    if (type == ASTNode::Type::Add || type == ASTNode::Type::Multiply) {
+        std::vector<std::unique_ptr<const ASTNode>> operands;
+        collectChain(std::move(node), type, operands);
+        for (auto &operand : operands) {
+            operand = reassociate(std::move(operand));
+        }
+        return buildBalanced(type, operands, 0, operands.size());
+    }
+
+    rewriteChildren(node, [](std::unique_ptr<const ASTNode> child) { return reassociate(std::move(child)); });
+    return node;
+}
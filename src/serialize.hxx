@@ -0,0 +1,505 @@
+#pragma once
+
+#include "hash.hxx"
+#include "mapping.hxx"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Binary program image: a flat, position-independent encoding of expression trees that can be mapped from a
+// file and evaluated in place.
+//
+// Layout (little-endian, every section 8-byte aligned, all offsets relative to the start of the image):
+//
+//     ImageHeader                 magic, format version, byte-order mark, size, checksum, section offsets
+//     ImageProgram[programs]      first instruction, instruction count and stack depth of each tree
+//     ImageInstruction[...]       postfix code of all trees
+//     double[constants]           constant values and polynomial coefficients
+//     uint32[names + 1], chars    identifier name table: offsets into the character data that follows
+//
+// The checksum is FNV-1a over the whole image, with the header's checksum field read as zero. Loading validates
+// the header, checksum, bounds and stack discipline of every program once; evaluation then interprets the
+// mapped instructions directly.
+namespace image {
+
+constexpr char magic[8] = {'A', 'S', 'T', 'I', 'M', 'G', '\0', '\0'};
+constexpr std::uint32_t formatVersion = 2;
+constexpr std::uint32_t byteOrderMark = 0x01020304;
+
+// Operation codes of the postfix code.
+enum class Op : std::uint8_t {
+    Constant,    // Push constants[operand].
+    Identifier,  // Push the variable names[operand].
+    Plus,        // No-op, kept so that trees round-trip exactly.
+    Negate,      // Replace the top value by its negation.
+    Add,         // Pop two values, push their sum; likewise for the other binary operators.
+    Subtract,
+    Multiply,
+    Divide,
+    Power,
+    MultiplyAdd, // Pop a, b, c, push fma(a, b, c).
+    Polynomial,  // Replace x by the polynomial with count coefficients at constants[operand].
+    Sum,         // Pop count values, push their left-to-right sum (0 if count is 0).
+    Product,     // Pop count values, push their left-to-right product (1 if count is 0).
+    Count
+};
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t size;
+    std::uint64_t checksum;
+    std::uint32_t programCount;
+    std::uint32_t instructionCount;
+    std::uint32_t constantCount;
+    std::uint32_t nameCount;
+    std::uint64_t programsOffset;
+    std::uint64_t instructionsOffset;
+    std::uint64_t constantsOffset;
+    std::uint64_t namesOffset;
+};
+
+struct Program {
+    std::uint32_t first;
+    std::uint32_t count;
+    std::uint32_t maxStack;
+    std::uint32_t reserved;
+};
+
+struct Instruction {
+    Op op;
+    std::uint8_t reserved;
+    std::uint16_t count;
+    std::uint32_t operand;
+};
+
+static_assert(sizeof(Header) % 8 == 0 && sizeof(Program) == 16 && sizeof(Instruction) == 8, "packed layout");
+
+// Stack effect of an instruction: values popped and pushed.
+inline std::uint32_t pops(const Instruction &instruction) {
+    switch (instruction.op) {
+    case Op::Constant:
+    case Op::Identifier:
+        return 0;
+    case Op::Plus:
+    case Op::Negate:
+    case Op::Polynomial:
+        return 1;
+    case Op::MultiplyAdd:
+        return 3;
+    case Op::Sum:
+    case Op::Product:
+        return instruction.count;
+    default:
+        return 2;
+    }
+}
+
+// Checksum of an image: the header with its checksum field zeroed, then everything after it.
+inline std::uint64_t checksum(const char *data, std::size_t size) {
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    header.checksum = 0;
+    std::uint64_t hash = hashName(std::string_view(reinterpret_cast<const char *>(&header), sizeof(header)));
+    return hashName(std::string_view(data + sizeof(Header), size - sizeof(Header)), hash);
+}
+
+} // namespace image
+
+// Builds a program image from trees.
+class ProgramImageWriter {
+    std::vector<image::Program> programs;
+    std::vector<image::Instruction> code;
+    std::vector<double> constants;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, std::uint32_t> nameIndex;
+
+    static std::uint16_t checkedCount(std::size_t count) {
+        if (count > UINT16_MAX) {
+            throw std::length_error("ProgramImageWriter: too many operands");
+        }
+        return static_cast<std::uint16_t>(count);
+    }
+
+    void emit(image::Op op, std::uint32_t operand = 0, std::uint16_t count = 0) {
+        code.push_back(image::Instruction{op, 0, count, operand});
+    }
+
+    // Emits postfix code for node; depth is the stack depth before it, maxDepth the running maximum.
+    void emitTree(const ASTNode &node, std::uint32_t depth, std::uint32_t &maxDepth) {
+        maxDepth = std::max(maxDepth, depth + 1);
+        ASTNode::Type type = node.getType();
+        std::uint32_t childDepth = depth;
+        if (type != ASTNode::Type::Constant && type != ASTNode::Type::Identifier) {
+            forEachChild(node, [&](const ASTNode &child) { emitTree(child, childDepth++, maxDepth); });
+        }
+        switch (type) {
+        case ASTNode::Type::Constant:
+            emit(image::Op::Constant, static_cast<std::uint32_t>(constants.size()));
+            constants.push_back(static_cast<const Constant &>(node).getValue());
+            return;
+        case ASTNode::Type::Identifier: {
+            const std::string &name = static_cast<const Identifier &>(node).getIdentifier();
+            auto it = nameIndex.emplace(name, static_cast<std::uint32_t>(names.size())).first;
+            if (it->second == names.size()) {
+                names.push_back(name);
+            }
+            emit(image::Op::Identifier, it->second);
+            return;
+        }
+        case ASTNode::Type::UnaryPlus:
+            return emit(image::Op::Plus);
+        case ASTNode::Type::UnaryMinus:
+            return emit(image::Op::Negate);
+        case ASTNode::Type::Add:
+            return emit(image::Op::Add);
+        case ASTNode::Type::Subtract:
+            return emit(image::Op::Subtract);
+        case ASTNode::Type::Multiply:
+            return emit(image::Op::Multiply);
+        case ASTNode::Type::Divide:
+            return emit(image::Op::Divide);
+        case ASTNode::Type::Power:
+            return emit(image::Op::Power);
+        case ASTNode::Type::MultiplyAdd:
+            return emit(image::Op::MultiplyAdd);
+        case ASTNode::Type::Polynomial: {
+            const auto &coefficients = static_cast<const Polynomial &>(node).getCoefficients();
+            emit(image::Op::Polynomial, static_cast<std::uint32_t>(constants.size()),
+                 checkedCount(coefficients.size()));
+            constants.insert(constants.end(), coefficients.begin(), coefficients.end());
+            return;
+        }
+        case ASTNode::Type::Sum:
+        case ASTNode::Type::Product: {
+            std::uint16_t count = checkedCount(static_cast<const Nary &>(node).getOperandCount());
+            return emit(type == ASTNode::Type::Sum ? image::Op::Sum : image::Op::Product, 0, count);
+        }
+        default:
+            throw std::invalid_argument("ProgramImageWriter: unsupported node type");
+        }
+    }
+
+    template <typename T> static void append(std::vector<char> &bytes, const T *data, std::size_t count) {
+        const char *begin = reinterpret_cast<const char *>(data);
+        bytes.insert(bytes.end(), begin, begin + count * sizeof(T));
+        bytes.resize((bytes.size() + 7) & ~std::size_t(7));
+    }
+
+  public:
+    // Appends a tree; returns its program index in the image.
+    std::uint32_t add(const ASTNode &tree) {
+        image::Program program{static_cast<std::uint32_t>(code.size()), 0, 0, 0};
+        emitTree(tree, 0, program.maxStack);
+        program.count = static_cast<std::uint32_t>(code.size()) - program.first;
+        programs.push_back(program);
+        return static_cast<std::uint32_t>(programs.size() - 1);
+    }
+
+    // Number of programs added so far.
+    std::size_t size() const { return programs.size(); }
+
+    // Returns the encoded image.
+    std::vector<char> finish() const {
+        image::Header header{};
+        std::copy(std::begin(image::magic), std::end(image::magic), header.magic);
+        header.version = image::formatVersion;
+        header.byteOrder = image::byteOrderMark;
+        header.programCount = static_cast<std::uint32_t>(programs.size());
+        header.instructionCount = static_cast<std::uint32_t>(code.size());
+        header.constantCount = static_cast<std::uint32_t>(constants.size());
+        header.nameCount = static_cast<std::uint32_t>(names.size());
+
+        std::vector<char> bytes(sizeof(header));
+        header.programsOffset = bytes.size();
+        append(bytes, programs.data(), programs.size());
+        header.instructionsOffset = bytes.size();
+        append(bytes, code.data(), code.size());
+        header.constantsOffset = bytes.size();
+        append(bytes, constants.data(), constants.size());
+        header.namesOffset = bytes.size();
+        std::vector<std::uint32_t> offsets{0};
+        std::string characters;
+        for (const std::string &name : names) {
+            characters += name;
+            offsets.push_back(static_cast<std::uint32_t>(characters.size()));
+        }
+        append(bytes, offsets.data(), offsets.size());
+        append(bytes, characters.data(), characters.size());
+
+        header.size = bytes.size();
+        std::copy(reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header + 1), bytes.begin());
+        header.checksum = image::checksum(bytes.data(), bytes.size());
+        std::copy(reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header + 1), bytes.begin());
+        return bytes;
+    }
+
+    // Writes the image to path. The file is written under a temporary name and renamed into place, so readers
+    // never map a partial image.
+    void write(const std::string &path) const {
+        std::vector<char> bytes = finish();
+        writeFileReplacing(path, bytes.data(), bytes.size());
+    }
+};
+
+// Read-only view of a program image in memory. The image is validated once on construction; programs are then
+// evaluated straight from the encoded instructions, with identifiers looked up through their interned symbols.
+class ProgramImage {
+    const image::Header *header;
+    const image::Program *programs;
+    const image::Instruction *code;
+    const double *constants;
+    std::vector<VariableStore::Symbol> symbols; // Interned symbol of each name in the image.
+    std::vector<std::string> names;
+
+    [[noreturn]] static void reject(const std::string &reason) {
+        throw std::runtime_error("ProgramImage: " + reason);
+    }
+
+    // Checks that [offset, offset + count * itemSize) lies inside the image and is 8-byte aligned.
+    static void checkSection(std::uint64_t offset, std::uint64_t count, std::size_t itemSize, std::size_t size) {
+        if (offset % 8 != 0 || offset > size || count > (size - offset) / itemSize) {
+            reject("section out of bounds");
+        }
+    }
+
+    // Checks operand indices and that the program leaves exactly one value without underflowing its stack.
+    void checkProgram(const image::Program &program) const {
+        if (program.first > header->instructionCount || program.count > header->instructionCount - program.first) {
+            reject("program out of bounds");
+        }
+        std::uint32_t depth = 0;
+        for (std::uint32_t i = program.first; i < program.first + program.count; ++i) {
+            const image::Instruction &instruction = code[i];
+            if (instruction.op >= image::Op::Count) {
+                reject("unknown operation");
+            }
+            std::uint32_t popped = image::pops(instruction);
+            if (depth < popped) {
+                reject("stack underflow");
+            }
+            std::uint64_t limit = instruction.op == image::Op::Identifier ? header->nameCount : header->constantCount;
+            std::uint64_t used = instruction.op == image::Op::Polynomial ? instruction.count : 1;
+            bool indexed = instruction.op == image::Op::Constant || instruction.op == image::Op::Identifier ||
+                           instruction.op == image::Op::Polynomial;
+            if (indexed && instruction.operand + used > limit) {
+                reject("operand out of bounds");
+            }
+            depth = depth - popped + 1;
+            if (depth > program.maxStack) {
+                reject("stack deeper than declared");
+            }
+        }
+        if (depth != 1) {
+            reject("program does not produce one value");
+        }
+    }
+
+  public:
+    // Validates the image at data, which must stay valid and unchanged while the view is used.
+    ProgramImage(const char *data, std::size_t size) {
+        if (size < sizeof(image::Header) || reinterpret_cast<std::uintptr_t>(data) % 8 != 0) {
+            reject("truncated or misaligned image");
+        }
+        header = reinterpret_cast<const image::Header *>(data);
+        if (!std::equal(std::begin(image::magic), std::end(image::magic), header->magic)) {
+            reject("not a program image");
+        }
+        if (header->version != image::formatVersion || header->byteOrder != image::byteOrderMark) {
+            reject("unsupported format version or byte order");
+        }
+        if (header->size != size || header->checksum != image::checksum(data, size)) {
+            reject("size or checksum mismatch");
+        }
+        checkSection(header->programsOffset, header->programCount, sizeof(image::Program), size);
+        checkSection(header->instructionsOffset, header->instructionCount, sizeof(image::Instruction), size);
+        checkSection(header->constantsOffset, header->constantCount, sizeof(double), size);
+        checkSection(header->namesOffset, std::uint64_t(header->nameCount) + 1, sizeof(std::uint32_t), size);
+        programs = reinterpret_cast<const image::Program *>(data + header->programsOffset);
+        code = reinterpret_cast<const image::Instruction *>(data + header->instructionsOffset);
+        constants = reinterpret_cast<const double *>(data + header->constantsOffset);
+
+        const auto *offsets = reinterpret_cast<const std::uint32_t *>(data + header->namesOffset);
+        // The character data starts at the next 8-byte boundary after the offsets.
+        std::uint64_t charactersOffset = header->namesOffset + ((std::uint64_t(header->nameCount) + 1) * 4 + 7) / 8 * 8;
+        if (charactersOffset > size) {
+            reject("name table out of bounds");
+        }
+        const char *characters = data + charactersOffset;
+        std::size_t available = static_cast<std::size_t>(size - charactersOffset);
+        for (std::uint32_t i = 0; i < header->nameCount; ++i) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > available) {
+                reject("name table out of bounds");
+            }
+            names.emplace_back(characters + offsets[i], offsets[i + 1] - offsets[i]);
+            symbols.push_back(Identifier::intern(names.back()));
+        }
+        for (std::uint32_t i = 0; i < header->programCount; ++i) {
+            checkProgram(programs[i]);
+        }
+    }
+
+    // Number of programs in the image.
+    std::size_t size() const { return header->programCount; }
+
+    // Evaluates a program with the same semantics as evaluating its tree.
+    double evaluate(std::size_t index) const {
+        const image::Program &program = programs[index];
+        double local[64];
+        std::vector<double> heap;
+        double *stack = local;
+        if (program.maxStack > 64) {
+            heap.resize(program.maxStack);
+            stack = heap.data();
+        }
+        std::size_t top = 0; // Number of values on the stack.
+        const VariableStore &store = Identifier::getVariableStore();
+        for (const image::Instruction *i = code + program.first, *end = i + program.count; i != end; ++i) {
+            switch (i->op) {
+            case image::Op::Constant:
+                stack[top++] = constants[i->operand];
+                break;
+            case image::Op::Identifier: {
+                double value;
+                if (!store.get(symbols[i->operand], value)) {
+                    std::cerr << "Error: Undefined variable '" << names[i->operand] << ".'\n";
+                    value = 0.0;
+                }
+                stack[top++] = value;
+                break;
+            }
+            case image::Op::Plus:
+                break;
+            case image::Op::Negate:
+                stack[top - 1] = -stack[top - 1];
+                break;
+            case image::Op::Add:
+                --top;
+                stack[top - 1] += stack[top];
+                break;
+            case image::Op::Subtract:
+                --top;
+                stack[top - 1] -= stack[top];
+                break;
+            case image::Op::Multiply:
+                --top;
+                stack[top - 1] *= stack[top];
+                break;
+            case image::Op::Divide:
+                --top;
+                if (stack[top] == 0) {
+                    std::cerr << "Error: Division by zero.\n";
+                    stack[top - 1] = INFINITY;
+                } else {
+                    stack[top - 1] /= stack[top];
+                }
+                break;
+            case image::Op::Power:
+                --top;
+                stack[top - 1] = std::pow(stack[top - 1], stack[top]);
+                break;
+            case image::Op::MultiplyAdd:
+                top -= 2;
+                stack[top - 1] = std::fma(stack[top - 1], stack[top], stack[top + 1]);
+                break;
+            case image::Op::Polynomial: {
+                const double *coefficients = constants + i->operand;
+                double x = stack[top - 1], result = i->count == 0 ? 0.0 : coefficients[i->count - 1];
+                for (std::size_t k = i->count == 0 ? 0 : i->count - 1; k-- > 0;) {
+                    result = std::fma(result, x, coefficients[k]);
+                }
+                stack[top - 1] = result;
+                break;
+            }
+            case image::Op::Sum:
+            case image::Op::Product: {
+                bool sum = i->op == image::Op::Sum;
+                if (i->count == 0) {
+                    stack[top++] = sum ? 0.0 : 1.0;
+                    break;
+                }
+                double *operands = stack + top - i->count;
+                double result = operands[0];
+                for (std::size_t k = 1; k < i->count; ++k) {
+                    result = sum ? result + operands[k] : result * operands[k];
+                }
+                top -= i->count - 1;
+                stack[top - 1] = result;
+                break;
+            }
+            default:
+                break;
+            }
+        }
+        return stack[0];
+    }
+
+    // Rebuilds the tree of a program, for passes and evaluators that need nodes.
+    std::unique_ptr<const ASTNode> toTree(std::size_t index) const {
+        const image::Program &program = programs[index];
+        std::vector<std::unique_ptr<const ASTNode>> stack;
+        auto pop = [&] {
+            std::unique_ptr<const ASTNode> node = std::move(stack.back());
+            stack.pop_back();
+            return node;
+        };
+        for (const image::Instruction *i = code + program.first, *end = i + program.count; i != end; ++i) {
+            switch (i->op) {
+            case image::Op::Constant:
+                stack.push_back(std::make_unique<Constant>(constants[i->operand]));
+                break;
+            case image::Op::Identifier:
+                stack.push_back(std::make_unique<Identifier>(names[i->operand]));
+                break;
+            case image::Op::Plus:
+                stack.push_back(std::make_unique<UnaryPlus>(pop()));
+                break;
+            case image::Op::Negate:
+                stack.push_back(std::make_unique<UnaryMinus>(pop()));
+                break;
+            case image::Op::MultiplyAdd: {
+                std::unique_ptr<const ASTNode> c = pop(), b = pop(), a = pop();
+                stack.push_back(std::make_unique<MultiplyAdd>(std::move(a), std::move(b), std::move(c)));
+                break;
+            }
+            case image::Op::Polynomial:
+                stack.push_back(std::make_unique<Polynomial>(
+                    pop(), std::vector<double>(constants + i->operand, constants + i->operand + i->count)));
+                break;
+            case image::Op::Sum:
+            case image::Op::Product: {
+                std::vector<std::unique_ptr<const ASTNode>> operands(i->count);
+                for (std::size_t k = i->count; k-- > 0;) {
+                    operands[k] = pop();
+                }
+                if (i->op == image::Op::Sum) {
+                    stack.push_back(std::make_unique<Sum>(std::move(operands)));
+                } else {
+                    stack.push_back(std::make_unique<Product>(std::move(operands)));
+                }
+                break;
+            }
+            default: {
+                static const ASTNode::Type types[] = {ASTNode::Type::Add, ASTNode::Type::Subtract,
+                                                      ASTNode::Type::Multiply, ASTNode::Type::Divide,
+                                                      ASTNode::Type::Power};
+                std::unique_ptr<const ASTNode> right = pop(), left = pop();
+                std::size_t offset = static_cast<std::size_t>(i->op) - static_cast<std::size_t>(image::Op::Add);
+                stack.push_back(makeBinary(types[offset], std::move(left), std::move(right)));
+                break;
+            }
+            }
+        }
+        return pop();
+    }
+};
+
+// A program image file mapped into memory and validated; programs are evaluated in place.
+class MappedProgramImage : private FileMapping, public ProgramImage {
+  public:
+    explicit MappedProgramImage(const std::string &path)
+        : FileMapping(path), ProgramImage(FileMapping::data(), FileMapping::size()) {}
+
+    using ProgramImage::size;
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+#include "hash.hxx"
+#include "variables.hxx"
+#include <cerrno>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+// Variables in a POSIX shared-memory segment, written by one process and read by any number of others.
+//
+// The segment holds a header, a fixed-capacity name directory and an array of value words. A name is published
+// by writing its text and then storing its slot number into the directory entry, so readers in other processes
+// can probe the directory without locks, exactly like VariableStore's in-process directory. Values are atomic
+// 64-bit words holding the bits of a double, so a single read never tears. Every update is bracketed by the
+// segment's sequence counter (a seqlock), and read() gives a consistent snapshot across several variables.
+//
+// attach() binds every name in the segment into a VariableStore, so Identifier nodes in the reading process
+// evaluate straight from shared memory with no copy-in step; the segment must outlive those bindings. Only one
+// process may write a segment.
+class SharedVariableSegment {
+  public:
+    static constexpr std::size_t maxNameLength = 59;
+
+  private:
+    static constexpr std::uint64_t magic = 0x6173742d76617273; // "ast-vars"
+    static constexpr std::uint32_t layoutVersion = 2;
+
+    struct Header {
+        std::atomic<std::uint64_t> magic;    // Stored last by the creator.
+        std::uint32_t version;               // Layout version.
+        std::uint32_t capacity;              // Maximum number of variables.
+        std::uint32_t directorySize;         // Power of two, at least twice the capacity.
+        std::atomic<std::uint32_t> count;    // Number of variables published.
+        std::atomic<std::uint64_t> sequence; // Odd while an update is in progress.
+    };
+
+    struct Name {
+        std::atomic<std::uint32_t> slot; // Slot number plus one; zero while the entry is free.
+        char text[maxNameLength + 1];
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared atomics must be address-free");
+    static_assert(sizeof(Header) <= 64 && sizeof(Name) == 64, "unexpected segment layout");
+
+    bool writable;
+    int descriptor = -1;
+    std::size_t size = 0;
+    void *mapping = nullptr;
+    Header *header = nullptr;
+    Name *names = nullptr;
+    std::atomic<std::uint64_t> *values = nullptr;
+    // What attach() last bound: the store, its generation (advanced by clear()) and the number of variables.
+    const VariableStore *attachedStore = nullptr;
+    std::uint64_t attachedGeneration = 0;
+    std::uint32_t attached = 0;
+
+    static std::size_t directorySizeFor(std::uint32_t capacity) {
+        std::size_t size = 2;
+        while (size < 2 * std::size_t(capacity)) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    static std::size_t bytesFor(std::uint32_t capacity, std::size_t directorySize) {
+        return 64 + directorySize * sizeof(Name) + capacity * sizeof(std::uint64_t);
+    }
+
+    void map(int protection) {
+        mapping = mmap(nullptr, size, protection, MAP_SHARED, descriptor, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            throw std::system_error(errno, std::generic_category(), "SharedVariableSegment: mmap");
+        }
+        header = static_cast<Header *>(mapping);
+    }
+
+    void locate() {
+        names = reinterpret_cast<Name *>(static_cast<char *>(mapping) + 64);
+        values = reinterpret_cast<std::atomic<std::uint64_t> *>(names + header->directorySize);
+    }
+
+    void release() {
+        if (mapping != nullptr) {
+            munmap(mapping, size);
+        }
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+    }
+
+    // Returns the directory entry for name, or the free entry where it would be inserted.
+    Name &entryFor(std::string_view name) const {
+        std::size_t mask = header->directorySize - 1;
+        for (std::size_t i = hashName(name) & mask;; i = (i + 1) & mask) {
+            Name &entry = names[i];
+            if (entry.slot.load(std::memory_order_acquire) == 0 || name == entry.text) {
+                return entry;
+            }
+        }
+    }
+
+    void requireWritable() const {
+        if (!writable) {
+            throw std::logic_error("SharedVariableSegment: opened read-only");
+        }
+    }
+
+  public:
+    // Creates the segment called name with room for capacity variables, for writing. An existing segment of
+    // that name is unlinked rather than truncated, so processes that have it mapped keep their old values.
+    SharedVariableSegment(const std::string &name, std::uint32_t capacity) : writable(true) {
+        std::size_t directorySize = directorySizeFor(capacity);
+        size = bytesFor(capacity, directorySize);
+        shm_unlink(name.c_str());
+        descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (descriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "SharedVariableSegment: shm_open " + name);
+        }
+        if (ftruncate(descriptor, static_cast<off_t>(size)) != 0) {
+            int error = errno;
+            release();
+            throw std::system_error(error, std::generic_category(), "SharedVariableSegment: ftruncate");
+        }
+        try {
+            map(PROT_READ | PROT_WRITE);
+        } catch (...) {
+            release();
+            throw;
+        }
+        // The new pages are zero, which is the initial state of every atomic in the layout.
+        header->version = layoutVersion;
+        header->capacity = capacity;
+        header->directorySize = static_cast<std::uint32_t>(directorySize);
+        locate();
+        header->magic.store(magic, std::memory_order_release);
+    }
+
+    // Opens the existing segment called name for reading.
+    explicit SharedVariableSegment(const std::string &name) : writable(false) {
+        descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+        if (descriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "SharedVariableSegment: shm_open " + name);
+        }
+        struct stat status;
+        if (fstat(descriptor, &status) != 0 || status.st_size < 64) {
+            release();
+            throw std::runtime_error("SharedVariableSegment: " + name + " is not a variable segment");
+        }
+        size = static_cast<std::size_t>(status.st_size);
+        try {
+            map(PROT_READ);
+        } catch (...) {
+            release();
+            throw;
+        }
+        if (header->magic.load(std::memory_order_acquire) != magic || header->version != layoutVersion ||
+            header->directorySize != directorySizeFor(header->capacity) ||
+            size < bytesFor(header->capacity, header->directorySize)) {
+            release();
+            throw std::runtime_error("SharedVariableSegment: " + name + " has an incompatible layout");
+        }
+        locate();
+    }
+
+    SharedVariableSegment(const SharedVariableSegment &) = delete;
+    SharedVariableSegment &operator=(const SharedVariableSegment &) = delete;
+
+    ~SharedVariableSegment() { release(); }
+
+    // Removes the segment name; processes that have it mapped keep their mapping.
+    static void unlink(const std::string &name) { shm_unlink(name.c_str()); }
+
+    // Number of variables published in the segment.
+    std::uint32_t getCount() const { return header->count.load(std::memory_order_acquire); }
+
+    // Looks up a variable without locking. Returns false if the segment does not contain it.
+    bool get(std::string_view name, double &value) const {
+        const Name &entry = entryFor(name);
+        std::uint32_t slot = entry.slot.load(std::memory_order_acquire);
+        if (slot == 0) {
+            return false;
+        }
+        value = VariableStore::fromBits(values[slot - 1].load(std::memory_order_acquire));
+        return true;
+    }
+
+    // Runs function, which should only read the segment, until no update overlapped it. Returns its result.
+    template <typename Function> auto read(Function function) const -> decltype(function()) {
+        for (;;) {
+            std::uint64_t before = header->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto result = function();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->sequence.load(std::memory_order_relaxed) == before) {
+                return result;
+            }
+        }
+    }
+
+    // Applies update(SharedVariableSegment &), which calls setUnsequenced(), as one atomic change.
+    template <typename Update> void write(Update update) {
+        requireWritable();
+        std::uint64_t odd = header->sequence.load(std::memory_order_relaxed) + 1;
+        header->sequence.store(odd, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        try {
+            update(*this);
+        } catch (...) {
+            header->sequence.store(odd + 1, std::memory_order_release);
+            throw;
+        }
+        header->sequence.store(odd + 1, std::memory_order_release);
+    }
+
+    // Sets a variable, publishing its name the first time. Only valid inside write().
+    void setUnsequenced(std::string_view name, double value) {
+        requireWritable();
+        Name &entry = entryFor(name);
+        std::uint32_t slot = entry.slot.load(std::memory_order_relaxed);
+        if (slot == 0) {
+            if (name.size() > maxNameLength) {
+                throw std::invalid_argument("SharedVariableSegment: name too long");
+            }
+            slot = header->count.load(std::memory_order_relaxed) + 1;
+            if (slot > header->capacity) {
+                throw std::length_error("SharedVariableSegment: segment is full");
+            }
+            values[slot - 1].store(VariableStore::toBits(value), std::memory_order_relaxed);
+            name.copy(entry.text, name.size());
+            entry.text[name.size()] = '\0';
+            entry.slot.store(slot, std::memory_order_release);
+            header->count.store(slot, std::memory_order_release);
+            return;
+        }
+        values[slot - 1].store(VariableStore::toBits(value), std::memory_order_release);
+    }
+
+    // Sets a single variable.
+    void set(std::string_view name, double value) {
+        write([&](SharedVariableSegment &segment) { segment.setUnsequenced(name, value); });
+    }
+
+    // Binds every variable of the segment not yet attached into store, so evaluation reads shared memory
+    // directly. Call again to pick up variables the writer has added since, or after store.clear().
+    void attach(VariableStore &store) {
+        std::uint32_t count = getCount();
+        auto current = [&] { return &store == attachedStore && store.getGeneration() == attachedGeneration; };
+        if (current() && attached == count) {
+            return;
+        }
+        store.write([&](VariableStore::Writer &writer) {
+            // Writes are serialized, so no clear() can slip in between this check and the bindings.
+            std::uint32_t first = current() ? attached : 0;
+            for (std::size_t i = 0; i < header->directorySize; ++i) {
+                std::uint32_t slot = names[i].slot.load(std::memory_order_acquire);
+                if (slot > first && slot <= count) {
+                    writer.bind(names[i].text, &values[slot - 1]);
+                }
+            }
+            attachedGeneration = store.getGeneration();
+        });
+        attachedStore = &store;
+        attached = count;
+    }
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "transform.hxx"
+#include <vector>
+
+// Options controlling the algebraic simplifier.
+struct SimplifyOptions {
+    bool strictIEEE = true;            // Only apply rewrites that preserve NaN, infinities and the sign of zero.
+    std::size_t maxRewrites = 1 << 20; // Safety bound on the number of rewrites applied to one tree.
+};
+
+// A peephole rewrite matched on the type of the root node.
+struct RewriteRule {
+    const char *name;
+    ASTNode::Type type; // Root node type the rule applies to.
+    bool ieeeSafe;      // False if the rewrite can change results for NaN, infinities or signed zero.
+    bool (*matches)(const ASTNode &node);
+    std::unique_ptr<const ASTNode> (*apply)(std::unique_ptr<const ASTNode> node);
+};
+
+// Accessors used by the rules below.
+inline const ASTNode &inputOf(const ASTNode &node) { return static_cast<const Unary &>(node).getInput(); }
+inline const ASTNode &leftOf(const ASTNode &node) { return static_cast<const Binary &>(node).getLeft(); }
+inline const ASTNode &rightOf(const ASTNode &node) { return static_cast<const Binary &>(node).getRight(); }
+inline std::unique_ptr<const ASTNode> takeInput(std::unique_ptr<const ASTNode> node) {
+    return mutableUnary(node).releaseInput();
+}
+inline std::unique_ptr<const ASTNode> takeLeft(std::unique_ptr<const ASTNode> node) {
+    return mutableBinary(node).releaseLeft();
+}
+inline std::unique_ptr<const ASTNode> takeRight(std::unique_ptr<const ASTNode> node) {
+    return mutableBinary(node).releaseRight();
+}
+
+// Returns the operand of a binary node that is not the constant value (checking the right operand first).
+inline std::unique_ptr<const ASTNode> takeOtherOperand(std::unique_ptr<const ASTNode> node, double value) {
+    return isConstant(rightOf(*node), value) ? takeLeft(std::move(node)) : takeRight(std::move(node));
+}
+
+// Constant folding matcher: both operands are constants, and a division is not by zero so the runtime
+// division-by-zero report is kept.
+inline bool foldableBinary(const ASTNode &node) {
+    if (leftOf(node).getType() != ASTNode::Type::Constant || rightOf(node).getType() != ASTNode::Type::Constant) {
+        return false;
+    }
+    return node.getType() != ASTNode::Type::Divide || static_cast<const Constant &>(rightOf(node)).getValue() != 0;
+}
+
+// Constant folding rewrite.
+inline std::unique_ptr<const ASTNode> foldBinary(std::unique_ptr<const ASTNode> node) {
+    return std::make_unique<Constant>(node->evaluate());
+}
+
+// The rule set, grouped by root type. Rules only combine already-simplified operands, so reapplying the
+// table at the rewritten root is enough to reach a fixed point.
+inline const std::vector<RewriteRule> &rewriteRules() {
+    using Ptr = std::unique_ptr<const ASTNode>;
+    using T = ASTNode::Type;
+    static const std::vector<RewriteRule> rules = {
+        // +x -> x
+        {"unary-plus", T::UnaryPlus, true, [](const ASTNode &) { return true; },
+         [](Ptr node) { return takeInput(std::move(node)); }},
+        // -(-x) -> x
+        {"double-negation", T::UnaryMinus, true,
+         [](const ASTNode &node) { return inputOf(node).getType() == T::UnaryMinus; },
+         [](Ptr node) { return takeInput(takeInput(std::move(node))); }},
+        // -c -> constant
+        {"negate-constant", T::UnaryMinus, true,
+         [](const ASTNode &node) { return inputOf(node).getType() == T::Constant; },
+         [](Ptr node) -> Ptr { return std::make_unique<Constant>(node->evaluate()); }},
+
+        // c1 op c2 -> constant
+        {"fold-add", T::Add, true, foldableBinary, foldBinary},
+        {"fold-subtract", T::Subtract, true, foldableBinary, foldBinary},
+        {"fold-multiply", T::Multiply, true, foldableBinary, foldBinary},
+        {"fold-divide", T::Divide, true, foldableBinary, foldBinary},
+        {"fold-power", T::Power, true, foldableBinary, foldBinary},
+
+        // x + (-0) -> x, (-0) + x -> x
+        {"add-negative-zero", T::Add, true,
+         [](const ASTNode &node) { return isConstant(rightOf(node), -0.0) || isConstant(leftOf(node), -0.0); },
+         [](Ptr node) { return takeOtherOperand(std::move(node), -0.0); }},
+        // x + (-y) -> x - y
+        {"add-negation", T::Add, true, [](const ASTNode &node) { return rightOf(node).getType() == T::UnaryMinus; },
+         [](Ptr node) -> Ptr {
+             Ptr left = mutableBinary(node).releaseLeft();
+             return std::make_unique<Subtract>(std::move(left), takeInput(takeRight(std::move(node))));
+         }},
+        // x - 0 -> x
+        {"subtract-zero", T::Subtract, true, [](const ASTNode &node) { return isConstant(rightOf(node), 0.0); },
+         [](Ptr node) { return takeLeft(std::move(node)); }},
+        // x - (-y) -> x + y
+        {"subtract-negation", T::Subtract, true,
+         [](const ASTNode &node) { return rightOf(node).getType() == T::UnaryMinus; },
+         [](Ptr node) -> Ptr {
+             Ptr left = mutableBinary(node).releaseLeft();
+             return std::make_unique<Add>(std::move(left), takeInput(takeRight(std::move(node))));
+         }},
+        // x * 1 -> x, 1 * x -> x
+        {"multiply-one", T::Multiply, true,
+         [](const ASTNode &node) { return isConstant(rightOf(node), 1.0) || isConstant(leftOf(node), 1.0); },
+         [](Ptr node) { return takeOtherOperand(std::move(node), 1.0); }},
+        // x * -1 -> -x, -1 * x -> -x
+        {"multiply-minus-one", T::Multiply, true,
+         [](const ASTNode &node) { return isConstant(rightOf(node), -1.0) || isConstant(leftOf(node), -1.0); },
+         [](Ptr node) -> Ptr {
+             return std::make_unique<UnaryMinus>(takeOtherOperand(std::move(node), -1.0));
+         }},
+        // x / 1 -> x
+        {"divide-one", T::Divide, true, [](const ASTNode &node) { return isConstant(rightOf(node), 1.0); },
+         [](Ptr node) { return takeLeft(std::move(node)); }},
+        // x ^ 1 -> x
+        {"power-one", T::Power, true, [](const ASTNode &node) { return isConstant(rightOf(node), 1.0); },
+         [](Ptr node) { return takeLeft(std::move(node)); }},
+        // x ^ 0 -> 1 (std::pow returns 1 for a zero exponent even when x is NaN)
+        {"power-zero", T::Power, true,
+         [](const ASTNode &node) { return isConstant(rightOf(node), 0.0) || isConstant(rightOf(node), -0.0); },
+         [](Ptr) -> Ptr { return std::make_unique<Constant>(1.0); }},
+
+        // Relaxed rules, only applied when strictIEEE is off.
+
+        // x + 0 -> x, 0 + x -> x (wrong for x = -0)
+        {"add-zero", T::Add, false,
+         [](const ASTNode &node) { return isConstant(rightOf(node), 0.0) || isConstant(leftOf(node), 0.0); },
+         [](Ptr node) { return takeOtherOperand(std::move(node), 0.0); }},
+        // 0 - x -> -x (wrong for x = 0)
+        {"zero-minus", T::Subtract, false, [](const ASTNode &node) { return isConstant(leftOf(node), 0.0); },
+         [](Ptr node) -> Ptr { return std::make_unique<UnaryMinus>(takeRight(std::move(node))); }},
+        // x - x -> 0 (wrong for NaN and infinities)
+        {"subtract-self", T::Subtract, false,
+         [](const ASTNode &node) { return sameTree(leftOf(node), rightOf(node)); },
+         [](Ptr) -> Ptr { return std::make_unique<Constant>(0.0); }},
+        // x * 0 -> 0, 0 * x -> 0 (wrong for NaN, infinities and negative x)
+        {"multiply-zero", T::Multiply, false,
+         [](const ASTNode &node) { return isConstant(rightOf(node), 0.0) || isConstant(leftOf(node), 0.0); },
+         [](Ptr) -> Ptr { return std::make_unique<Constant>(0.0); }},
+        // x / x -> 1 (wrong for zero, NaN and infinities)
+        {"divide-self", T::Divide, false, [](const ASTNode &node) { return sameTree(leftOf(node), rightOf(node)); },
+         [](Ptr) -> Ptr { return std::make_unique<Constant>(1.0); }},
+    };
+    return rules;
+}
+
+// Applies the rule table to node, whose operands are already simplified, until no rule matches.
+inline std::unique_ptr<const ASTNode> rewriteRoot(std::unique_ptr<const ASTNode> node, const SimplifyOptions &options,
+                                                  std::size_t &budget) {
+    bool changed = true;
+    while (changed && budget > 0) {
+        changed = false;
+        for (const RewriteRule &rule : rewriteRules()) {
+            if (rule.type != node->getType() || (options.strictIEEE && !rule.ieeeSafe) || !rule.matches(*node)) {
+                continue;
+            }
+            node = rule.apply(std::move(node));
+            --budget;
+            changed = true;
+            break;
+        }
+    }
+    return node;
+}
+
+// Simplifies operands bottom-up, then rewrites the root to a fixed point.
+inline std::unique_ptr<const ASTNode> simplifyNode(std::unique_ptr<const ASTNode> node, const SimplifyOptions &options,
+                                                   std::size_t &budget) {
+    rewriteChildren(node, [&](std::unique_ptr<const ASTNode> child) {
+        return simplifyNode(std::move(child), options, budget);
+    });
+    return rewriteRoot(std::move(node), options, budget);
+}
+
+// Applies algebraic identities (x * 1, x + -0, +x, -(-x), constant folding, ...) until the tree stops
+// changing. With strictIEEE off, identities that only hold for finite, non-negative-zero values are used too.
+inline std::unique_ptr<const ASTNode> simplify(std::unique_ptr<const ASTNode> node,
+                                               const SimplifyOptions &options = SimplifyOptions()) {
+    std::size_t budget = options.maxRewrites;
+    return simplifyNode(std::move(node), options, budget);
+}
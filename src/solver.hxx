@@ -0,0 +1,353 @@
+#pragma once
+
+#include "transform.hxx"
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tuning parameters for the nonlinear system solver.
+struct SolverOptions {
+    std::size_t maxIterations = 100; // Upper bound on accepted and rejected steps.
+    double tolerance = 1e-12;        // Convergence threshold on the largest residual and on the step size.
+    double initialDamping = 1e-3;    // Starting Levenberg-Marquardt damping; 0 starts as a pure Newton step.
+};
+
+// Outcome of a single solve.
+struct SolverResult {
+    bool converged = false;
+    std::size_t iterations = 0;
+    double residualNorm = 0.0; // Largest absolute residual at the returned point.
+};
+
+// Newton / Levenberg-Marquardt solver for systems of equations given as ASTs.
+//
+// Each equation is an expression whose root is driven to zero. Residuals and the full Jacobian row of every
+// equation are computed together in one forward-mode automatic differentiation pass over the tree. All
+// workspace is sized in the constructor, so repeated calls to solve() do not allocate.
+class NewtonSolver {
+  private:
+    std::vector<const ASTNode *> equations;
+    std::unordered_map<const ASTNode *, std::size_t> unknownNodes; // Identifier node -> unknown index.
+    std::size_t unknownCount;
+    std::size_t maxDepth = 0;
+
+    // Workspace reused across solves.
+    std::vector<double> tape;                    // Two gradient rows per tree depth.
+    std::vector<double> residual, trialResidual; // m
+    std::vector<double> jacobian, trialJacobian; // m x n, row-major.
+    std::vector<double> normalMatrix, gradient;  // n x n and n
+    std::vector<double> step, trialPoint;        // n
+
+    // Records every Identifier node naming an unknown and the depth of the tree.
+    void index(const ASTNode &node, const std::unordered_map<std::string, std::size_t> &names, std::size_t depth) {
+        maxDepth = std::max(maxDepth, depth);
+        if (node.getType() == ASTNode::Type::Identifier) {
+            auto it = names.find(static_cast<const Identifier &>(node).getIdentifier());
+            if (it != names.end()) {
+                unknownNodes[&node] = it->second;
+            }
+        }
+        forEachChild(node, [&](const ASTNode &child) { index(child, names, depth + 1); });
+    }
+
+    // Evaluates node at point x and writes its gradient with respect to the unknowns into grad.
+    double differentiate(const ASTNode &node, const double *x, double *grad, std::size_t depth) {
+        const std::size_t n = unknownCount;
+        switch (node.getType()) {
+        case ASTNode::Type::Constant:
+            std::fill(grad, grad + n, 0.0);
+            return static_cast<const Constant &>(node).getValue();
+        case ASTNode::Type::Identifier: {
+            std::fill(grad, grad + n, 0.0);
+            auto it = unknownNodes.find(&node);
+            if (it == unknownNodes.end()) {
+                return node.evaluate();
+            }
+            grad[it->second] = 1.0;
+            return x[it->second];
+        }
+        case ASTNode::Type::UnaryPlus:
+            return differentiate(static_cast<const Unary &>(node).getInput(), x, grad, depth + 1);
+        case ASTNode::Type::UnaryMinus: {
+            double value = differentiate(static_cast<const Unary &>(node).getInput(), x, grad, depth + 1);
+            for (std::size_t i = 0; i < n; ++i) {
+                grad[i] = -grad[i];
+            }
+            return -value;
+        }
+        case ASTNode::Type::Polynomial: {
+            // p(u)' = p'(u) * u', with p and p' evaluated together in Horner form.
+            const auto &polynomial = static_cast<const Polynomial &>(node);
+            const std::vector<double> &c = polynomial.getCoefficients();
+            double u = differentiate(polynomial.getInput(), x, grad, depth + 1);
+            double value = 0.0, slope = 0.0;
+            for (std::size_t k = c.size(); k-- > 0;) {
+                slope = slope * u + value;
+                value = value * u + c[k];
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                grad[i] *= slope;
+            }
+            return value;
+        }
+        case ASTNode::Type::Sum:
+        case ASTNode::Type::Product: {
+            const auto &nary = static_cast<const Nary &>(node);
+            bool sum = node.getType() == ASTNode::Type::Sum;
+            double *operandGrad = tape.data() + 2 * depth * n;
+            double value = sum ? 0.0 : 1.0;
+            std::fill(grad, grad + n, 0.0);
+            for (std::size_t k = 0; k < nary.getOperandCount(); ++k) {
+                double operand = differentiate(nary.getOperand(k), x, k == 0 ? grad : operandGrad, depth + 1);
+                if (k == 0) {
+                    value = operand;
+                    continue;
+                }
+                for (std::size_t i = 0; i < n; ++i) {
+                    grad[i] = sum ? grad[i] + operandGrad[i] : grad[i] * operand + value * operandGrad[i];
+                }
+                value = sum ? value + operand : value * operand;
+            }
+            return value;
+        }
+        case ASTNode::Type::MultiplyAdd: {
+            const auto &fma = static_cast<const MultiplyAdd &>(node);
+            double *multiplierGrad = tape.data() + 2 * depth * n, *addendGrad = multiplierGrad + n;
+            double a = differentiate(fma.getMultiplicand(), x, grad, depth + 1);
+            double b = differentiate(fma.getMultiplier(), x, multiplierGrad, depth + 1);
+            double c = differentiate(fma.getAddend(), x, addendGrad, depth + 1);
+            for (std::size_t i = 0; i < n; ++i) {
+                grad[i] = grad[i] * b + a * multiplierGrad[i] + addendGrad[i];
+            }
+            return std::fma(a, b, c);
+        }
+        case ASTNode::Type::Add:
+        case ASTNode::Type::Subtract:
+        case ASTNode::Type::Multiply:
+        case ASTNode::Type::Divide:
+        case ASTNode::Type::Power:
+            break;
+        default:
+            throw std::invalid_argument("NewtonSolver: unsupported node type");
+        }
+
+        const auto &binary = static_cast<const Binary &>(node);
+        double *rightGrad = tape.data() + 2 * depth * n;
+        double l = differentiate(binary.getLeft(), x, grad, depth + 1);
+        double r = differentiate(binary.getRight(), x, rightGrad, depth + 1);
+
+        switch (node.getType()) {
+        case ASTNode::Type::Add:
+            for (std::size_t i = 0; i < n; ++i) {
+                grad[i] += rightGrad[i];
+            }
+            return l + r;
+        case ASTNode::Type::Subtract:
+            for (std::size_t i = 0; i < n; ++i) {
+                grad[i] -= rightGrad[i];
+            }
+            return l - r;
+        case ASTNode::Type::Multiply:
+            for (std::size_t i = 0; i < n; ++i) {
+                grad[i] = grad[i] * r + l * rightGrad[i];
+            }
+            return l * r;
+        case ASTNode::Type::Divide: {
+            double value = l / r;
+            for (std::size_t i = 0; i < n; ++i) {
+                grad[i] = (grad[i] - value * rightGrad[i]) / r;
+            }
+            return value;
+        }
+        default: { // Power
+            double value = std::pow(l, r);
+            bool constantExponent = std::all_of(rightGrad, rightGrad + n, [](double g) { return g == 0.0; });
+            if (constantExponent) {
+                double scale = r * std::pow(l, r - 1.0);
+                for (std::size_t i = 0; i < n; ++i) {
+                    grad[i] *= scale;
+                }
+            } else {
+                double logBase = std::log(l);
+                for (std::size_t i = 0; i < n; ++i) {
+                    grad[i] = value * (rightGrad[i] * logBase + r * grad[i] / l);
+                }
+            }
+            return value;
+        }
+        }
+    }
+
+    // Computes all residuals and Jacobian rows at x; returns half the squared residual norm.
+    double linearize(const double *x, std::vector<double> &res, std::vector<double> &jac) {
+        double cost = 0.0;
+        for (std::size_t row = 0; row < equations.size(); ++row) {
+            res[row] = differentiate(*equations[row], x, jac.data() + row * unknownCount, 1);
+            cost += 0.5 * res[row] * res[row];
+        }
+        return cost;
+    }
+
+    // Solves (J^T J + damping * diag(J^T J)) step = -J^T r by Cholesky factorization in place.
+    bool solveDampedNormalEquations(double damping) {
+        const std::size_t n = unknownCount, m = equations.size();
+        for (std::size_t i = 0; i < n; ++i) {
+            double g = 0.0;
+            for (std::size_t k = 0; k < m; ++k) {
+                g += jacobian[k * n + i] * residual[k];
+            }
+            gradient[i] = g;
+            for (std::size_t j = 0; j <= i; ++j) {
+                double a = 0.0;
+                for (std::size_t k = 0; k < m; ++k) {
+                    a += jacobian[k * n + i] * jacobian[k * n + j];
+                }
+                normalMatrix[i * n + j] = a;
+            }
+            normalMatrix[i * n + i] += damping * std::max(normalMatrix[i * n + i], 1e-12);
+        }
+
+        // Lower-triangular Cholesky factor overwrites the lower half of normalMatrix.
+        for (std::size_t j = 0; j < n; ++j) {
+            double d = normalMatrix[j * n + j];
+            for (std::size_t k = 0; k < j; ++k) {
+                d -= normalMatrix[j * n + k] * normalMatrix[j * n + k];
+            }
+            if (!(d > 0.0)) {
+                return false;
+            }
+            d = std::sqrt(d);
+            normalMatrix[j * n + j] = d;
+            for (std::size_t i = j + 1; i < n; ++i) {
+                double s = normalMatrix[i * n + j];
+                for (std::size_t k = 0; k < j; ++k) {
+                    s -= normalMatrix[i * n + k] * normalMatrix[j * n + k];
+                }
+                normalMatrix[i * n + j] = s / d;
+            }
+        }
+
+        // Forward then backward substitution.
+        for (std::size_t i = 0; i < n; ++i) {
+            double s = -gradient[i];
+            for (std::size_t k = 0; k < i; ++k) {
+                s -= normalMatrix[i * n + k] * step[k];
+            }
+            step[i] = s / normalMatrix[i * n + i];
+        }
+        for (std::size_t i = n; i-- > 0;) {
+            double s = step[i];
+            for (std::size_t k = i + 1; k < n; ++k) {
+                s -= normalMatrix[k * n + i] * step[k];
+            }
+            step[i] = s / normalMatrix[i * n + i];
+        }
+        return true;
+    }
+
+    // Largest absolute entry of a vector.
+    static double maxNorm(const std::vector<double> &v) {
+        double norm = 0.0;
+        for (double e : v) {
+            norm = std::max(norm, std::abs(e));
+        }
+        return norm;
+    }
+
+  public:
+    // Constructor for NewtonSolver. The equations are borrowed and must outlive the solver.
+    NewtonSolver(std::vector<const ASTNode *> equations, const std::vector<std::string> &unknowns)
+        : equations(std::move(equations)), unknownCount(unknowns.size()) {
+        std::unordered_map<std::string, std::size_t> names;
+        for (std::size_t i = 0; i < unknowns.size(); ++i) {
+            names.emplace(unknowns[i], i);
+        }
+        for (const ASTNode *equation : this->equations) {
+            index(*equation, names, 1);
+        }
+
+        const std::size_t n = unknownCount, m = this->equations.size();
+        tape.assign(2 * (maxDepth + 1) * n, 0.0);
+        residual.assign(m, 0.0);
+        trialResidual.assign(m, 0.0);
+        jacobian.assign(m * n, 0.0);
+        trialJacobian.assign(m * n, 0.0);
+        normalMatrix.assign(n * n, 0.0);
+        gradient.assign(n, 0.0);
+        step.assign(n, 0.0);
+        trialPoint.assign(n, 0.0);
+    }
+
+    // Solves the system starting from x, which is updated in place with the best point found.
+    SolverResult solve(std::vector<double> &x, const SolverOptions &options = SolverOptions()) {
+        if (x.size() != unknownCount) {
+            throw std::invalid_argument("NewtonSolver: initial guess has the wrong size");
+        }
+
+        SolverResult result;
+        double damping = options.initialDamping;
+        double cost = linearize(x.data(), residual, jacobian);
+
+        while (result.iterations < options.maxIterations) {
+            if (maxNorm(residual) <= options.tolerance) {
+                result.converged = true;
+                break;
+            }
+            ++result.iterations;
+
+            if (!solveDampedNormalEquations(damping)) {
+                damping = std::max(damping * 10.0, 1e-3);
+                continue;
+            }
+            for (std::size_t i = 0; i < unknownCount; ++i) {
+                trialPoint[i] = x[i] + step[i];
+            }
+
+            double trialCost = linearize(trialPoint.data(), trialResidual, trialJacobian);
+            if (trialCost < cost) {
+                x.swap(trialPoint);
+                residual.swap(trialResidual);
+                jacobian.swap(trialJacobian);
+                cost = trialCost;
+                damping /= 3.0;
+                if (maxNorm(step) <= options.tolerance * (1.0 + maxNorm(x))) {
+                    result.converged = maxNorm(residual) <= std::sqrt(options.tolerance);
+                    break;
+                }
+            } else {
+                damping = std::max(damping * 10.0, 1e-3);
+            }
+        }
+
+        result.residualNorm = maxNorm(residual);
+        return result;
+    }
+};
+
+// Solves many independent systems in parallel. Each system has its own solver, so the workers never share a
+// workspace; guesses[i] is updated in place and results[i] receives the outcome of solvers[i].
+inline void solveBatch(std::vector<NewtonSolver> &solvers, std::vector<std::vector<double>> &guesses,
+                       std::vector<SolverResult> &results, const SolverOptions &options = SolverOptions(),
+                       unsigned threadCount = std::thread::hardware_concurrency()) {
+    if (guesses.size() != solvers.size()) {
+        throw std::invalid_argument("solveBatch: one initial guess is required per system");
+    }
+    results.resize(solvers.size());
+    threadCount = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(solvers.size())));
+
+    auto worker = [&](unsigned id) {
+        for (std::size_t i = id; i < solvers.size(); i += threadCount) {
+            results[i] = solvers[i].solve(guesses[i], options);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned id = 1; id < threadCount; ++id) {
+        threads.emplace_back(worker, id);
+    }
+    worker(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "simplify.hxx"
+#include <string>
+#include <unordered_map>
+
+// Replaces identifiers that appear in bindings with their values.
+inline std::unique_ptr<const ASTNode> bindIdentifiers(std::unique_ptr<const ASTNode> node,
+                                                      const std::unordered_map<std::string, double> &bindings) {
+    if (node->getType() == ASTNode::Type::Identifier) {
+        auto it = bindings.find(static_cast<const Identifier &>(*node).getIdentifier());
+        if (it != bindings.end()) {
+            return std::make_unique<Constant>(it->second);
+        }
+        return node;
+    }
+    rewriteChildren(node, [&](std::unique_ptr<const ASTNode> child) {
+        return bindIdentifiers(std::move(child), bindings);
+    });
+    return node;
+}
+
+// Folds every node whose operands are all constants into a Constant, bottom-up. This covers the node types the
+// simplifier does not fold (Polynomial, MultiplyAdd, Sum, Product) and uses the node's own evaluate(), so the
+// folded value is exactly what the tree would have produced. Division by zero is left for the runtime report.
+inline std::unique_ptr<const ASTNode> foldConstants(std::unique_ptr<const ASTNode> node) {
+    rewriteChildren(node, [](std::unique_ptr<const ASTNode> child) { return foldConstants(std::move(child)); });
+    ASTNode::Type type = node->getType();
+    if (type == ASTNode::Type::Constant || type == ASTNode::Type::Identifier) {
+        return node;
+    }
+    bool constant = true;
+    forEachChild(*node, [&](const ASTNode &child) {
+        constant = constant && child.getType() == ASTNode::Type::Constant;
+    });
+    if (!constant || (type == ASTNode::Type::Divide && !foldableBinary(*node))) {
+        return node;
+    }
+    return std::make_unique<Constant>(node->evaluate());
+}
+
+// Partially evaluates node for fixed values of some of its identifiers.
+//
+// The bound identifiers are replaced by constants, constant subtrees are folded and the result is simplified,
+// leaving a residual tree over the remaining identifiers. The input is not modified, so a long-lived formula
+// can be re-specialized whenever its parameters change; the cost is one copy and a few linear passes.
+inline std::unique_ptr<const ASTNode> specialize(const ASTNode &node,
+                                                 const std::unordered_map<std::string, double> &bindings,
+                                                 const SimplifyOptions &options = SimplifyOptions()) {
+    return simplify(foldConstants(bindIdentifiers(clone(node), bindings)), options);
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "ast.hxx"
+
+// Helpers shared by the tree rewriting passes.
+//
+// Passes take ownership of a tree through std::unique_ptr<const ASTNode>, detach or replace its operands and
+// hand back the rewritten tree. Every node is created non-const by std::make_unique, so casting away const on
+// a node the pass exclusively owns is well defined.
+
+// Returns the unary node owned by node for in-place rewriting.
+inline Unary &mutableUnary(const std::unique_ptr<const ASTNode> &node) {
+    return const_cast<Unary &>(static_cast<const Unary &>(*node));
+}
+
+// Returns the binary node owned by node for in-place rewriting.
+inline Binary &mutableBinary(const std::unique_ptr<const ASTNode> &node) {
+    return const_cast<Binary &>(static_cast<const Binary &>(*node));
+}
+
+// Returns the multiply-add node owned by node for in-place rewriting.
+inline MultiplyAdd &mutableMultiplyAdd(const std::unique_ptr<const ASTNode> &node) {
+    return const_cast<MultiplyAdd &>(static_cast<const MultiplyAdd &>(*node));
+}
+
+// Returns the n-ary node owned by node for in-place rewriting.
+inline Nary &mutableNary(const std::unique_ptr<const ASTNode> &node) {
+    return const_cast<Nary &>(static_cast<const Nary &>(*node));
+}
+
+// Returns true for the node types derived from Unary.
+inline bool isUnary(ASTNode::Type type) {
+    return type == ASTNode::Type::UnaryPlus || type == ASTNode::Type::UnaryMinus;
+}
+
+// Returns true for the node types derived from Binary.
+inline bool isBinary(ASTNode::Type type) {
+    switch (type) {
+    case ASTNode::Type::Add:
+    case ASTNode::Type::Subtract:
+    case ASTNode::Type::Multiply:
+    case ASTNode::Type::Divide:
+    case ASTNode::Type::Power:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Returns true for the node types derived from Nary.
+inline bool isNary(ASTNode::Type type) { return type == ASTNode::Type::Sum || type == ASTNode::Type::Product; }
+
+// Calls visit on every operand of node, left to right.
+template <typename Visit> void forEachChild(const ASTNode &node, Visit visit) {
+    ASTNode::Type type = node.getType();
+    if (isUnary(type) || type == ASTNode::Type::Polynomial) {
+        visit(static_cast<const Unary &>(node).getInput());
+    } else if (isBinary(type)) {
+        visit(static_cast<const Binary &>(node).getLeft());
+        visit(static_cast<const Binary &>(node).getRight());
+    } else if (type == ASTNode::Type::MultiplyAdd) {
+        const auto &fma = static_cast<const MultiplyAdd &>(node);
+        visit(fma.getMultiplicand());
+        visit(fma.getMultiplier());
+        visit(fma.getAddend());
+    } else if (isNary(type)) {
+        const auto &nary = static_cast<const Nary &>(node);
+        for (std::size_t i = 0; i < nary.getOperandCount(); ++i) {
+            visit(nary.getOperand(i));
+        }
+    }
+}
+
+// Replaces every operand of an exclusively owned node with rewrite(operand), left to right.
+template <typename Rewrite> void rewriteChildren(const std::unique_ptr<const ASTNode> &node, Rewrite rewrite) {
+    ASTNode::Type type = node->getType();
+    if (isUnary(type) || type == ASTNode::Type::Polynomial) {
+        Unary &unary = mutableUnary(node);
+        unary.resetInput(rewrite(unary.releaseInput()));
+    } else if (isBinary(type)) {
+        Binary &binary = mutableBinary(node);
+        binary.resetLeft(rewrite(binary.releaseLeft()));
+        binary.resetRight(rewrite(binary.releaseRight()));
+    } else if (type == ASTNode::Type::MultiplyAdd) {
+        MultiplyAdd &fma = mutableMultiplyAdd(node);
+        fma.resetMultiplicand(rewrite(fma.releaseMultiplicand()));
+        fma.resetMultiplier(rewrite(fma.releaseMultiplier()));
+        fma.resetAddend(rewrite(fma.releaseAddend()));
+    } else if (isNary(type)) {
+        Nary &nary = mutableNary(node);
+        for (std::size_t i = 0; i < nary.getOperandCount(); ++i) {
+            nary.resetOperand(i, rewrite(nary.releaseOperand(i)));
+        }
+    }
+}
+
+// Returns true if node is a Constant holding exactly value (including the sign of zero).
+inline bool isConstant(const ASTNode &node, double value) {
+    if (node.getType() != ASTNode::Type::Constant) {
+        return false;
+    }
+    double constant = static_cast<const Constant &>(node).getValue();
+    return constant == value && std::signbit(constant) == std::signbit(value);
+}
+
+// Factory function creating a unary node of the given type.
+inline std::unique_ptr<const ASTNode> makeUnary(ASTNode::Type type, std::unique_ptr<const ASTNode> operand) {
+    switch (type) {
+    case ASTNode::Type::UnaryPlus:
+        return std::make_unique<UnaryPlus>(std::move(operand));
+    case ASTNode::Type::UnaryMinus:
+        return std::make_unique<UnaryMinus>(std::move(operand));
+    default:
+        throw std::invalid_argument("makeUnary: not a unary node type");
+    }
+}
+
+// Factory function creating a binary node of the given type.
+inline std::unique_ptr<const ASTNode> makeBinary(ASTNode::Type type, std::unique_ptr<const ASTNode> left,
+                                                 std::unique_ptr<const ASTNode> right) {
+    switch (type) {
+    case ASTNode::Type::Add:
+        return std::make_unique<Add>(std::move(left), std::move(right));
+    case ASTNode::Type::Subtract:
+        return std::make_unique<Subtract>(std::move(left), std::move(right));
+    case ASTNode::Type::Multiply:
+        return std::make_unique<Multiply>(std::move(left), std::move(right));
+    case ASTNode::Type::Divide:
+        return std::make_unique<Divide>(std::move(left), std::move(right));
+    case ASTNode::Type::Power:
+        return std::make_unique<Power>(std::move(left), std::move(right));
+    default:
+        throw std::invalid_argument("makeBinary: not a binary node type");
+    }
+}
+
+// Creates a deep copy of a tree.
+inline std::unique_ptr<const ASTNode> clone(const ASTNode &node) {
+    ASTNode::Type type = node.getType();
+    if (type == ASTNode::Type::Constant) {
+        return std::make_unique<Constant>(static_cast<const Constant &>(node).getValue());
+    }
+    if (type == ASTNode::Type::Identifier) {
+        return std::make_unique<Identifier>(static_cast<const Identifier &>(node).getIdentifier());
+    }
+    if (isUnary(type)) {
+        return makeUnary(type, clone(static_cast<const Unary &>(node).getInput()));
+    }
+    if (isBinary(type)) {
+        const auto &binary = static_cast<const Binary &>(node);
+        return makeBinary(type, clone(binary.getLeft()), clone(binary.getRight()));
+    }
+    if (type == ASTNode::Type::Polynomial) {
+        const auto &polynomial = static_cast<const Polynomial &>(node);
+        return std::make_unique<Polynomial>(clone(polynomial.getInput()), polynomial.getCoefficients());
+    }
+    if (type == ASTNode::Type::MultiplyAdd) {
+        const auto &fma = static_cast<const MultiplyAdd &>(node);
+        return std::make_unique<MultiplyAdd>(clone(fma.getMultiplicand()), clone(fma.getMultiplier()),
+                                             clone(fma.getAddend()));
+    }
+    if (isNary(type)) {
+        const auto &nary = static_cast<const Nary &>(node);
+        std::vector<std::unique_ptr<const ASTNode>> operands;
+        for (std::size_t i = 0; i < nary.getOperandCount(); ++i) {
+            operands.push_back(clone(nary.getOperand(i)));
+        }
+        if (type == ASTNode::Type::Sum) {
+            return std::make_unique<Sum>(std::move(operands));
+        }
+        return std::make_unique<Product>(std::move(operands));
+    }
+    throw std::invalid_argument("clone: unsupported node type");
+}
+
+// Returns true if both trees have the same shape, operators, constants and identifiers.
+inline bool sameTree(const ASTNode &a, const ASTNode &b) {
+    ASTNode::Type type = a.getType();
+    if (type != b.getType()) {
+        return false;
+    }
+    if (type == ASTNode::Type::Constant) {
+        return isConstant(b, static_cast<const Constant &>(a).getValue());
+    }
+    if (type == ASTNode::Type::Identifier) {
+        return static_cast<const Identifier &>(a).getSymbol() == static_cast<const Identifier &>(b).getSymbol();
+    }
+    if (isUnary(type)) {
+        return sameTree(static_cast<const Unary &>(a).getInput(), static_cast<const Unary &>(b).getInput());
+    }
+    if (isBinary(type)) {
+        const auto &x = static_cast<const Binary &>(a), &y = static_cast<const Binary &>(b);
+        return sameTree(x.getLeft(), y.getLeft()) && sameTree(x.getRight(), y.getRight());
+    }
+    if (type == ASTNode::Type::MultiplyAdd) {
+        const auto &x = static_cast<const MultiplyAdd &>(a), &y = static_cast<const MultiplyAdd &>(b);
+        return sameTree(x.getMultiplicand(), y.getMultiplicand()) && sameTree(x.getMultiplier(), y.getMultiplier()) &&
+               sameTree(x.getAddend(), y.getAddend());
+    }
+    if (type == ASTNode::Type::Polynomial) {
+        const auto &x = static_cast<const Polynomial &>(a), &y = static_cast<const Polynomial &>(b);
+        return x.getCoefficients() == y.getCoefficients() && sameTree(x.getInput(), y.getInput());
+    }
+    if (isNary(type)) {
+        const auto &x = static_cast<const Nary &>(a), &y = static_cast<const Nary &>(b);
+        if (x.getOperandCount() != y.getOperandCount()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < x.getOperandCount(); ++i) {
+            if (!sameTree(x.getOperand(i), y.getOperand(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
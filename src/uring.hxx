@@ -0,0 +1,411 @@
+#pragma once
+
+#include "csv.hxx"
+#include <cstdlib>
+#include <linux/io_uring.h>
+#include <new>
+#include <string_view>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+// Minimal io_uring instance driven through the raw system calls, for queued file reads.
+//
+// The submission and completion rings are shared with the kernel through mmap; the application writes
+// submission entries and advances the submission tail, the kernel advances the completion tail, and each side
+// publishes its index with a release store that the other side reads with an acquire load.
+class IoUring {
+    int ring = -1;
+    io_uring_params params{};
+    void *submissionMapping = nullptr, *completionMapping = nullptr;
+    std::size_t submissionBytes = 0, completionBytes = 0;
+    io_uring_sqe *entries = nullptr;
+    unsigned *submissionTail, *submissionMask, *submissionArray;
+    unsigned *completionHead, *completionTail, *completionMask;
+    io_uring_cqe *completions;
+    unsigned pending = 0;     // Entries queued but not yet published to the kernel.
+    unsigned unsubmitted = 0; // Entries published but not yet consumed by io_uring_enter.
+
+    void enter(unsigned minComplete, unsigned flags) {
+        long consumed = syscall(__NR_io_uring_enter, ring, unsubmitted, minComplete, flags, nullptr, 0);
+        if (consumed < 0) {
+            if (errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+            }
+            return;
+        }
+        unsubmitted -= static_cast<unsigned>(consumed);
+    }
+
+    template <typename T> T *at(void *base, std::size_t offset) {
+        return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+    }
+
+    void release() {
+        if (entries != nullptr) {
+            munmap(entries, params.sq_entries * sizeof(io_uring_sqe));
+        }
+        if (completionMapping != nullptr && completionMapping != submissionMapping) {
+            munmap(completionMapping, completionBytes);
+        }
+        if (submissionMapping != nullptr) {
+            munmap(submissionMapping, submissionBytes);
+        }
+        if (ring >= 0) {
+            close(ring);
+        }
+    }
+
+  public:
+    // Creates a ring with room for depth entries; throws std::system_error if io_uring is unavailable.
+    explicit IoUring(unsigned depth) {
+        ring = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+        if (ring < 0) {
+            throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+        }
+        submissionBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        completionBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            submissionBytes = completionBytes = std::max(submissionBytes, completionBytes);
+        }
+        submissionMapping = mmap(nullptr, submissionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring,
+                                 IORING_OFF_SQ_RING);
+        completionMapping = single ? submissionMapping
+                                   : mmap(nullptr, completionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          ring, IORING_OFF_CQ_RING);
+        void *sqes = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        if (submissionMapping == MAP_FAILED || completionMapping == MAP_FAILED || sqes == MAP_FAILED) {
+            int error = errno;
+            submissionMapping = submissionMapping == MAP_FAILED ? nullptr : submissionMapping;
+            completionMapping = completionMapping == MAP_FAILED ? nullptr : completionMapping;
+            entries = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe *>(sqes);
+            release();
+            throw std::system_error(error, std::generic_category(), "io_uring mmap");
+        }
+        entries = static_cast<io_uring_sqe *>(sqes);
+        submissionTail = at<unsigned>(submissionMapping, params.sq_off.tail);
+        submissionMask = at<unsigned>(submissionMapping, params.sq_off.ring_mask);
+        submissionArray = at<unsigned>(submissionMapping, params.sq_off.array);
+        completionHead = at<unsigned>(completionMapping, params.cq_off.head);
+        completionTail = at<unsigned>(completionMapping, params.cq_off.tail);
+        completionMask = at<unsigned>(completionMapping, params.cq_off.ring_mask);
+        completions = at<io_uring_cqe>(completionMapping, params.cq_off.cqes);
+    }
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    ~IoUring() { release(); }
+
+    // Queues a read of iov->iov_len bytes at offset of descriptor into iov->iov_base, tagged with tag. The iovec
+    // must stay valid until the read completes. At most depth reads may be outstanding.
+    void queueRead(int descriptor, const iovec *iov, std::uint64_t offset, std::uint64_t tag) {
+        unsigned tail = *submissionTail + pending;
+        unsigned index = tail & *submissionMask;
+        io_uring_sqe &entry = entries[index];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.opcode = IORING_OP_READV;
+        entry.fd = descriptor;
+        entry.off = offset;
+        entry.addr = reinterpret_cast<std::uint64_t>(iov);
+        entry.len = 1;
+        entry.user_data = tag;
+        submissionArray[index] = index;
+        ++pending;
+    }
+
+    // Hands the queued reads to the kernel without waiting for them.
+    void submit() {
+        if (pending != 0) {
+            __atomic_store_n(submissionTail, *submissionTail + pending, __ATOMIC_RELEASE);
+            unsubmitted += pending;
+            pending = 0;
+        }
+        if (unsubmitted != 0) {
+            enter(0, 0);
+        }
+    }
+
+    // Submits the queued reads and waits for a completion; returns its tag and result (bytes read or a negated
+    // errno).
+    std::pair<std::uint64_t, int> wait() {
+        submit();
+        for (;;) {
+            unsigned head = *completionHead;
+            if (head != __atomic_load_n(completionTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe &completion = completions[head & *completionMask];
+                std::pair<std::uint64_t, int> result{completion.user_data, completion.res};
+                __atomic_store_n(completionHead, head + 1, __ATOMIC_RELEASE);
+                return result;
+            }
+            enter(1, IORING_ENTER_GETEVENTS);
+        }
+    }
+};
+
+// Reads a file front to back in large blocks, keeping several reads in flight.
+//
+// With io_uring (the default when the kernel allows it) up to depth blocks are read ahead asynchronously, so
+// parsing one block overlaps the I/O of the next ones and the caller never takes a page fault. Without it the
+// reader falls back to one pread per block. Blocks are returned in file order.
+class BlockReader {
+    struct Slot {
+        char *buffer = nullptr;
+        iovec iov;
+        std::uint64_t offset = 0;
+        std::size_t expected = 0; // Bytes the block should hold.
+        std::size_t filled = 0;
+        bool done = false;
+    };
+
+    int descriptor;
+    std::uint64_t fileSize;
+    std::size_t blockBytes;
+    std::vector<Slot> slots;
+    std::unique_ptr<IoUring> ring;
+    std::uint64_t nextBlock = 0;      // Index of the block next() returns.
+    std::uint64_t submittedBlocks = 0; // Blocks handed to the ring so far.
+    bool holding = false;             // The block last returned is still with the caller.
+
+    // Queues the remainder of slot's block.
+    void queue(std::size_t index) {
+        Slot &slot = slots[index];
+        slot.iov.iov_base = slot.buffer + slot.filled;
+        slot.iov.iov_len = slot.expected - slot.filled;
+        ring->queueRead(descriptor, &slot.iov, slot.offset + slot.filled, index);
+    }
+
+    // Starts reading the next unread block into slot index, if any block is left.
+    void submit(std::size_t index) {
+        std::uint64_t offset = submittedBlocks * blockBytes;
+        if (offset >= fileSize) {
+            return;
+        }
+        Slot &slot = slots[index];
+        slot.offset = offset;
+        slot.expected = static_cast<std::size_t>(std::min<std::uint64_t>(blockBytes, fileSize - offset));
+        slot.filled = 0;
+        slot.done = false;
+        ++submittedBlocks;
+        queue(index);
+    }
+
+  public:
+    // Opens path for reading in blocks of blockBytes, rounded up to a multiple of 4096, with up to depth reads in
+    // flight. With useRing false, or if io_uring is unavailable, reads with pread.
+    explicit BlockReader(const std::string &path, std::size_t blockBytes = 1 << 20, std::size_t depth = 4,
+                         bool useRing = true)
+        : blockBytes((std::max<std::size_t>(4096, blockBytes) + 4095) / 4096 * 4096) {
+        descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        // Closes the descriptor and frees the buffers if the constructor throws after the open.
+        struct Guard {
+            BlockReader &reader;
+            bool armed = true;
+            ~Guard() {
+                if (armed) {
+                    reader.ring.reset();
+                    for (Slot &slot : reader.slots) {
+                        std::free(slot.buffer);
+                    }
+                    close(reader.descriptor);
+                }
+            }
+        } guard{*this};
+        struct stat status;
+        if (fstat(descriptor, &status) != 0) {
+            throw std::system_error(errno, std::generic_category(), "fstat " + path);
+        }
+        fileSize = static_cast<std::uint64_t>(status.st_size);
+        if (useRing) {
+            try {
+                ring = std::make_unique<IoUring>(static_cast<unsigned>(std::max<std::size_t>(1, depth)));
+            } catch (const std::system_error &) {
+            }
+        }
+        if (!ring) {
+            posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+        slots.resize(ring ? std::max<std::size_t>(1, depth) : 1);
+        for (Slot &slot : slots) {
+            slot.buffer = static_cast<char *>(std::aligned_alloc(4096, this->blockBytes));
+            if (slot.buffer == nullptr) {
+                throw std::bad_alloc();
+            }
+        }
+        if (ring) {
+            for (std::size_t i = 0; i < slots.size(); ++i) {
+                submit(i);
+            }
+            ring->submit();
+        }
+        guard.armed = false;
+    }
+
+    BlockReader(const BlockReader &) = delete;
+    BlockReader &operator=(const BlockReader &) = delete;
+
+    // Waits for reads still in flight, since the kernel writes into the buffers, then frees them.
+    ~BlockReader() {
+        if (ring) {
+            try {
+                for (std::uint64_t b = nextBlock; b < submittedBlocks; ++b) {
+                    while (!slots[b % slots.size()].done) {
+                        std::pair<std::uint64_t, int> completion = ring->wait();
+                        Slot &slot = slots[completion.first];
+                        slot.filled += completion.second > 0 ? static_cast<std::size_t>(completion.second) : 0;
+                        slot.done = completion.second <= 0 || slot.filled == slot.expected;
+                        if (!slot.done) {
+                            queue(completion.first);
+                        }
+                    }
+                }
+            } catch (const std::system_error &) {
+            }
+        }
+        ring.reset();
+        for (Slot &slot : slots) {
+            std::free(slot.buffer);
+        }
+        close(descriptor);
+    }
+
+    // Returns true if reads go through io_uring.
+    bool usesRing() const { return ring != nullptr; }
+
+    // Size of the file when it was opened.
+    std::uint64_t size() const { return fileSize; }
+
+    // Returns the next block, or an empty view at the end of the file. The block stays valid until the next call.
+    std::string_view next() {
+        if (nextBlock * blockBytes >= fileSize) {
+            return {};
+        }
+        if (!ring) {
+            Slot &slot = slots[0];
+            std::uint64_t offset = nextBlock * blockBytes;
+            slot.expected = static_cast<std::size_t>(std::min<std::uint64_t>(blockBytes, fileSize - offset));
+            for (slot.filled = 0; slot.filled < slot.expected;) {
+                ssize_t count = pread(descriptor, slot.buffer + slot.filled, slot.expected - slot.filled,
+                                      static_cast<off_t>(offset + slot.filled));
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (count <= 0) {
+                    throw std::system_error(count < 0 ? errno : EIO, std::generic_category(), "pread");
+                }
+                slot.filled += static_cast<std::size_t>(count);
+            }
+            ++nextBlock;
+            return std::string_view(slot.buffer, slot.filled);
+        }
+        // The caller is done with the previous block: reuse its slot for the next block to read ahead.
+        if (holding) {
+            submit(static_cast<std::size_t>((nextBlock - 1) % slots.size()));
+            ring->submit();
+        }
+        Slot &slot = slots[nextBlock % slots.size()];
+        while (!slot.done) {
+            std::pair<std::uint64_t, int> completion = ring->wait();
+            Slot &completed = slots[completion.first];
+            if (completion.second <= 0) {
+                int error = completion.second < 0 ? -completion.second : EIO; // A file that shrank reads as EIO.
+                completed.done = true;
+                throw std::system_error(error, std::generic_category(), "io_uring read");
+            }
+            completed.filled += static_cast<std::size_t>(completion.second);
+            completed.done = completed.filled == completed.expected;
+            if (!completed.done) {
+                queue(completion.first); // Short read: ask for the rest.
+            }
+        }
+        ++nextBlock;
+        holding = true;
+        return std::string_view(slot.buffer, slot.filled);
+    }
+};
+
+// CSV reader over a BlockReader: the same interface as CsvReader, for files read with io_uring or pread instead
+// of being mapped. Blocks are cut at their last newline; the partial line after it is carried over and joined
+// with the next block.
+class BlockCsvReader {
+    BlockReader blocks;
+    std::vector<char> window; // Carried-over partial line followed by the current block.
+    std::size_t carried = 0;  // Bytes at the end of window not yet handed to the parser.
+    bool finished = false;
+    std::unique_ptr<CsvReader> reader;
+
+    // Moves the unparsed tail to the front of window, appends blocks until it holds a newline or the file ends,
+    // and returns the length of the part that ends at the last newline (everything, at the end of the file).
+    std::size_t refill() {
+        if (carried != 0) {
+            std::memmove(window.data(), window.data() + window.size() - carried, carried);
+        }
+        window.resize(carried);
+        for (;;) {
+            std::string_view block = blocks.next();
+            if (block.empty()) {
+                finished = true;
+                carried = 0;
+                return window.size();
+            }
+            window.insert(window.end(), block.begin(), block.end());
+            std::size_t newline = block.rfind('\n');
+            if (newline != std::string_view::npos) {
+                carried = block.size() - (newline + 1);
+                return window.size() - carried;
+            }
+        }
+    }
+
+    // Calls read until it returns rows, refilling the window while the file has more.
+    template <typename Read> std::size_t readRows(Read read) {
+        for (;;) {
+            if (std::size_t rows = read()) {
+                return rows;
+            }
+            if (finished) {
+                return 0;
+            }
+            std::size_t length = refill();
+            reader->resume(window.data(), length);
+        }
+    }
+
+  public:
+    // Opens path; the arguments after it are those of BlockReader.
+    explicit BlockCsvReader(const std::string &path, std::size_t blockBytes = 1 << 20, std::size_t depth = 4,
+                            bool useRing = true)
+        : blocks(path, blockBytes, depth, useRing) {
+        std::size_t length = refill();
+        reader = std::make_unique<CsvReader>(window.data(), length, CsvReader::delimiterFor(path));
+    }
+
+    // Returns true if reads go through io_uring.
+    bool usesRing() const { return blocks.usesRing(); }
+
+    // Column names from the first line.
+    const std::vector<std::string> &getNames() const { return reader->getNames(); }
+
+    // Parses only the columns that expression reads.
+    void selectColumns(const ASTNode &expression) { reader->selectColumns(expression); }
+
+    // Returns true if column i is parsed.
+    bool isSelected(std::size_t i) const { return reader->isSelected(i); }
+
+    // Values of column i from the last read(maxRows).
+    const double *column(std::size_t i) const { return reader->column(i); }
+
+    // Parses up to maxRows rows, reading further blocks as needed; returns the number of rows read, 0 at the end.
+    std::size_t read(std::size_t maxRows) {
+        return readRows([&] { return reader->read(maxRows); });
+    }
+
+    // Like read(maxRows), parsing into caller buffers as CsvReader::read(maxRows, targets) does.
+    std::size_t read(std::size_t maxRows, double *const *targets) {
+        return readRows([&] { return reader->read(maxRows, targets); });
+    }
+};
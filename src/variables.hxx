@@ -0,0 +1,563 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <thread>
+#include <vector>
+
+// Variable store for many concurrent readers and a few writers.
+//
+// Readers never lock. Each variable lives in a slot whose value is an atomic 64-bit word; slots are allocated
+// in chunks that never move, so a slot address stays valid for the life of the store. Names are found through
+// an insert-only open-addressing directory that readers probe without locks; when it fills up a writer builds
+// a larger copy and publishes it with one atomic store. Replaced directories and all names are kept until the
+// store is destroyed, so a reader holding an old pointer is never left dangling (there is no reclamation to
+// get wrong, at the cost of at most doubling the directory memory).
+//
+// Writers take a mutex among themselves and bracket every update with a global sequence counter (a seqlock).
+// A single get() is always a value that was set at some point; read() reruns a function until it completes
+// without overlapping a write, so several variables are seen as one consistent snapshot. clear() bumps a
+// generation number instead of touching the slots, so it is O(1).
+//
+// Every write() that changes something advances the table version, and each changed variable records that
+// version, so dependents such as caches can tell exactly which inputs changed. Listeners subscribed to one
+// variable or to the whole table are called after the write completes, outside the writer lock.
+//
+// A variable can also be bound to caller memory, either a double or a field at a fixed offset inside whatever
+// object a caller-owned pointer currently points to. Reads then load the caller's data directly, with no
+// copy-in step. The caller keeps that memory alive and is responsible for synchronizing its own writes to it,
+// or binds an atomic word that another thread or process stores doubles into (see shared.hxx).
+class VariableStore {
+    // Where a bound variable is read from: *address, the bits of *word, or the double at offset bytes into
+    // *object.
+    struct Binding {
+        const double *address;
+        const void *const *object;
+        std::size_t offset;
+        const std::atomic<std::uint64_t> *word;
+
+        double load() const {
+            if (address != nullptr) {
+                return *address;
+            }
+            if (word != nullptr) {
+                return fromBits(word->load(std::memory_order_acquire));
+            }
+            double value;
+            std::memcpy(&value, static_cast<const char *>(*object) + offset, sizeof value);
+            return value;
+        }
+    };
+
+    // A slot's binding, rewritten in place when the variable is rebound so that rebinding never allocates.
+    // Readers copy it under its own sequence counter, so they never see half of an old and half of a new one.
+    struct BindingRecord {
+        std::atomic<std::uint64_t> sequence{0};
+        std::atomic<const double *> address{nullptr};
+        std::atomic<const void *const *> object{nullptr};
+        std::atomic<std::size_t> offset{0};
+        std::atomic<const std::atomic<std::uint64_t> *> word{nullptr};
+
+        // Returns the current binding, retrying while a rebind is in progress.
+        Binding get() const {
+            for (;;) {
+                std::uint64_t before = sequence.load(std::memory_order_acquire);
+                if (before & 1) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                Binding binding{address.load(std::memory_order_relaxed), object.load(std::memory_order_relaxed),
+                                offset.load(std::memory_order_relaxed), word.load(std::memory_order_relaxed)};
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == before) {
+                    return binding;
+                }
+            }
+        }
+
+        // Replaces the binding. Caller holds writerMutex.
+        void set(const Binding &binding) {
+            std::uint64_t odd = sequence.load(std::memory_order_relaxed) + 1;
+            sequence.store(odd, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            address.store(binding.address, std::memory_order_relaxed);
+            object.store(binding.object, std::memory_order_relaxed);
+            offset.store(binding.offset, std::memory_order_relaxed);
+            word.store(binding.word, std::memory_order_relaxed);
+            sequence.store(odd + 1, std::memory_order_release);
+        }
+    };
+
+    struct Slot {
+        std::atomic<std::uint64_t> bits{0};       // The value, as the bit pattern of a double.
+        std::atomic<std::uint64_t> generation{0}; // The value is defined iff this equals the store generation.
+        std::atomic<const BindingRecord *> binding{nullptr}; // If set, the value is read from caller memory.
+        std::atomic<std::uint64_t> version{0};    // Table version of the last change to this variable.
+        BindingRecord *record = nullptr;          // The slot's binding record, once bound. Writers only.
+    };
+
+    struct Entry {
+        std::string name;
+        std::size_t hash;
+        std::uint32_t slot;
+    };
+
+    struct Directory {
+        std::size_t mask;
+        std::unique_ptr<std::atomic<const Entry *>[]> entries;
+
+        explicit Directory(std::size_t capacity)
+            : mask(capacity - 1), entries(new std::atomic<const Entry *>[capacity]) {
+            for (std::size_t i = 0; i < capacity; ++i) {
+                entries[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        // Returns the entry for name, or nullptr.
+        const Entry *find(std::string_view name, std::size_t hash) const {
+            for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+                const Entry *entry = entries[i].load(std::memory_order_acquire);
+                if (entry == nullptr || (entry->hash == hash && entry->name == name)) {
+                    return entry;
+                }
+            }
+        }
+
+        // Publishes entry in the first free position of its probe sequence.
+        void insert(const Entry *entry) {
+            std::size_t i = entry->hash & mask;
+            while (entries[i].load(std::memory_order_relaxed) != nullptr) {
+                i = (i + 1) & mask;
+            }
+            entries[i].store(entry, std::memory_order_release);
+        }
+    };
+
+    static constexpr std::size_t chunkBits = 10;
+    static constexpr std::size_t chunkSize = std::size_t(1) << chunkBits;
+    static constexpr std::size_t maxChunks = 4096;
+
+    std::unique_ptr<std::atomic<Slot *>[]> chunks{new std::atomic<Slot *>[maxChunks]};
+    std::atomic<const Directory *> directory{nullptr};
+    std::atomic<std::uint64_t> generation{1};
+    std::atomic<std::uint64_t> sequence{0};
+    std::atomic<std::uint64_t> version{0};      // Table version: the number of writes that changed something.
+    std::atomic<std::uint64_t> clearVersion{0}; // Table version of the last clear().
+
+    // Owned by writers, under writerMutex.
+    std::mutex writerMutex;
+    std::vector<std::unique_ptr<Entry>> names;
+    std::vector<std::unique_ptr<Directory>> directories; // The current directory is the last one.
+    std::vector<std::unique_ptr<BindingRecord>> bindings; // One per slot ever bound, reused when rebound.
+    std::uint64_t pendingVersion = 0;                     // Version of the write in progress.
+    bool pendingChange = false, pendingClear = false;
+    std::vector<std::uint32_t> pendingChanges; // Changed symbols, recorded only while there are listeners.
+
+  public:
+    // Compact id of an interned name, the index of its slot. Valid for the life of the store.
+    using Symbol = std::uint32_t;
+    using SubscriptionId = std::uint64_t;
+
+    // Called with a changed variable and its new version; anySymbol stands for every variable after clear().
+    using Listener = std::function<void(Symbol symbol, std::uint64_t version)>;
+    static constexpr Symbol anySymbol = ~Symbol(0);
+
+  private:
+    using Subscriptions = std::vector<std::pair<SubscriptionId, std::shared_ptr<const Listener>>>;
+
+    // Listeners, under listenerMutex.
+    std::mutex listenerMutex;
+    std::unordered_map<Symbol, Subscriptions> listeners;
+    Subscriptions tableListeners;
+    SubscriptionId nextSubscription = 1;
+    std::atomic<bool> listening{false};
+
+    // Records a change of symbol by the write in progress. Caller holds writerMutex.
+    void markChanged(Slot &slot, Symbol symbol) {
+        slot.version.store(pendingVersion, std::memory_order_relaxed);
+        pendingChange = true;
+        if (listening.load(std::memory_order_relaxed)) {
+            pendingChanges.push_back(symbol);
+        }
+    }
+
+    // Stores a plain value in slot, replacing any binding. Caller holds writerMutex.
+    void storeValue(Slot &slot, Symbol symbol, double value) {
+        slot.bits.store(toBits(value), std::memory_order_relaxed);
+        slot.binding.store(nullptr, std::memory_order_relaxed);
+        markChanged(slot, symbol);
+        slot.generation.store(generation.load(std::memory_order_relaxed), std::memory_order_release);
+    }
+
+    // Calls the listeners for the changes of a completed write.
+    void notify(const std::vector<Symbol> &changes, bool cleared, std::uint64_t writeVersion) {
+        std::vector<std::pair<Symbol, std::shared_ptr<const Listener>>> calls;
+        {
+            std::lock_guard<std::mutex> lock(listenerMutex);
+            auto add = [&](Symbol symbol, const Subscriptions &subscriptions) {
+                for (const auto &subscription : subscriptions) {
+                    calls.emplace_back(symbol, subscription.second);
+                }
+            };
+            if (cleared) {
+                add(anySymbol, tableListeners);
+                for (const auto &entry : listeners) {
+                    add(anySymbol, entry.second);
+                }
+            }
+            for (Symbol symbol : changes) {
+                add(symbol, tableListeners);
+                auto it = listeners.find(symbol);
+                if (it != listeners.end()) {
+                    add(symbol, it->second);
+                }
+            }
+        }
+        for (const auto &call : calls) {
+            (*call.second)(call.first, writeVersion);
+        }
+    }
+
+    // Reads slot without locking. Returns false if it is not defined.
+    bool loadValue(const Slot &slot, double &value) const {
+        if (slot.generation.load(std::memory_order_acquire) != generation.load(std::memory_order_acquire)) {
+            return false;
+        }
+        const BindingRecord *binding = slot.binding.load(std::memory_order_acquire);
+        value = binding != nullptr ? binding->get().load() : fromBits(slot.bits.load(std::memory_order_relaxed));
+        return true;
+    }
+
+    // Returns the slot with the given index, which must have been allocated.
+    Slot &slotAt(std::size_t index) const {
+        return chunks[index >> chunkBits].load(std::memory_order_acquire)[index & (chunkSize - 1)];
+    }
+
+    // A clear() changes every variable without touching its slot, so it counts as a change of each.
+    std::uint64_t versionOf(const Slot &slot) const {
+        return std::max(slot.version.load(std::memory_order_acquire), clearVersion.load(std::memory_order_acquire));
+    }
+
+    const Entry *lookup(std::string_view name) const {
+        const Directory *current = directory.load(std::memory_order_acquire);
+        return current == nullptr ? nullptr : current->find(name, std::hash<std::string_view>()(name));
+    }
+
+    // Returns the slot index for name, registering it if needed. Caller holds writerMutex.
+    std::uint32_t slotFor(std::string_view name) {
+        std::size_t hash = std::hash<std::string_view>()(name);
+        const Directory *current = directories.empty() ? nullptr : directories.back().get();
+        if (current != nullptr) {
+            if (const Entry *entry = current->find(name, hash)) {
+                return entry->slot;
+            }
+        }
+
+        std::uint32_t index = static_cast<std::uint32_t>(names.size());
+        if (index >> chunkBits >= maxChunks) {
+            throw std::length_error("VariableStore: too many variables");
+        }
+        if ((index & (chunkSize - 1)) == 0) {
+            chunks[index >> chunkBits].store(new Slot[chunkSize], std::memory_order_release);
+        }
+        names.push_back(std::unique_ptr<Entry>(new Entry{std::string(name), hash, index}));
+
+        // Keep the directory at most half full so probe sequences stay short.
+        if (current == nullptr || 2 * names.size() > current->mask + 1) {
+            auto grown = std::make_unique<Directory>(current == nullptr ? 64 : 2 * (current->mask + 1));
+            for (const auto &entry : names) {
+                grown->insert(entry.get());
+            }
+            directory.store(grown.get(), std::memory_order_release);
+            directories.push_back(std::move(grown));
+        } else {
+            directories.back()->insert(names.back().get());
+        }
+        return index;
+    }
+
+  public:
+    // Bit pattern of a double, as stored in a slot or an atomic word, and back.
+    static std::uint64_t toBits(double value) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        return bits;
+    }
+
+    static double fromBits(std::uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof value);
+        return value;
+    }
+
+    // Handle to one variable, returned by registerVariable(). It points straight at the variable's slot, which
+    // never moves, so reads and writes through it skip both hashing and the chunk lookup, and it stays valid as
+    // the directory grows. Copyable and trivially cheap; valid for the life of the store.
+    class Handle {
+        friend class VariableStore;
+        VariableStore *store = nullptr;
+        Slot *slot = nullptr;
+        Symbol symbol = 0;
+        Handle(VariableStore &store, Symbol symbol) : store(&store), slot(&store.slotAt(symbol)), symbol(symbol) {}
+
+      public:
+        Handle() = default;
+
+        // The symbol of the variable.
+        Symbol getSymbol() const { return symbol; }
+
+        // Reads the variable without locking. Returns false if it is not defined.
+        bool get(double &value) const { return store->loadValue(*slot, value); }
+
+        // Table version of the last change to the variable.
+        std::uint64_t getVersion() const { return store->versionOf(*slot); }
+
+        // Sets the variable.
+        void set(double value) const {
+            store->write([&](Writer &writer) { writer.set(*this, value); });
+        }
+    };
+
+    // Batched update handed to write(); all of its changes become visible to read() together.
+    class Writer {
+        friend class VariableStore;
+        VariableStore &store;
+        explicit Writer(VariableStore &store) : store(store) {}
+
+        void bindTo(Symbol symbol, const Binding &binding) {
+            Slot &slot = store.slotAt(symbol);
+            if (slot.record == nullptr) {
+                store.bindings.push_back(std::make_unique<BindingRecord>());
+                slot.record = store.bindings.back().get();
+            }
+            slot.record->set(binding);
+            slot.binding.store(slot.record, std::memory_order_release);
+            store.markChanged(slot, symbol);
+            slot.generation.store(store.generation.load(std::memory_order_relaxed), std::memory_order_release);
+        }
+
+      public:
+        // Sets a variable.
+        void set(Symbol symbol, double value) { store.storeValue(store.slotAt(symbol), symbol, value); }
+
+        // Sets a variable through a handle from the same store.
+        void set(const Handle &handle, double value) { store.storeValue(*handle.slot, handle.symbol, value); }
+
+        // Sets a variable by name, creating it if needed.
+        void set(std::string_view name, double value) { set(store.slotFor(name), value); }
+
+        // Binds a variable to a caller-owned double, read on every access. set() replaces the binding.
+        void bind(std::string_view name, const double *address) {
+            bindTo(store.slotFor(name), Binding{address, nullptr, 0, nullptr});
+        }
+
+        // Binds a variable to an atomic word holding the bits of a double, written concurrently by someone else.
+        void bind(std::string_view name, const std::atomic<std::uint64_t> *word) {
+            bindTo(store.slotFor(name), Binding{nullptr, nullptr, 0, word});
+        }
+
+        // Binds a variable to the double at offset bytes into *object, for example offsetof(Quote, bid) with
+        // object pointing at the caller's current Quote pointer. Swapping that pointer rebinds without a write.
+        void bindField(std::string_view name, const void *const *object, std::size_t offset) {
+            bindTo(store.slotFor(name), Binding{nullptr, object, offset, nullptr});
+        }
+
+        // Makes every variable undefined.
+        void clear() {
+            store.generation.fetch_add(1, std::memory_order_release);
+            store.clearVersion.store(store.pendingVersion, std::memory_order_release);
+            store.pendingChange = store.pendingClear = true;
+        }
+    };
+
+    VariableStore() {
+        for (std::size_t i = 0; i < maxChunks; ++i) {
+            chunks[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    VariableStore(const VariableStore &) = delete;
+    VariableStore &operator=(const VariableStore &) = delete;
+
+    ~VariableStore() {
+        for (std::size_t i = 0; i < maxChunks; ++i) {
+            delete[] chunks[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Returns the symbol for name, registering the name (as an undefined variable) the first time. Known names
+    // are found without locking.
+    Symbol intern(std::string_view name) {
+        if (const Entry *entry = lookup(name)) {
+            return entry->slot;
+        }
+        std::lock_guard<std::mutex> lock(writerMutex);
+        return slotFor(name);
+    }
+
+    // Looks up a variable by name without locking. Returns false if it is not defined.
+    bool get(std::string_view name, double &value) const {
+        const Entry *entry = lookup(name);
+        return entry != nullptr && get(entry->slot, value);
+    }
+
+    // Looks up a variable by symbol without locking or hashing. Returns false if it is not defined.
+    bool get(Symbol symbol, double &value) const { return loadValue(slotAt(symbol), value); }
+
+    // Generation: advances on every clear(), which unbinds and undefines every variable.
+    std::uint64_t getGeneration() const { return generation.load(std::memory_order_acquire); }
+
+    // Table version: advances once for every write() that changes at least one variable.
+    std::uint64_t getVersion() const { return version.load(std::memory_order_acquire); }
+
+    // Table version of the last write that changed the variable (including clearing it).
+    std::uint64_t getVersion(Symbol symbol) const { return versionOf(slotAt(symbol)); }
+
+    // Returns true if the variable is bound to memory outside the store. Changes made through such memory do
+    // not advance any version.
+    bool isBound(Symbol symbol) const { return slotAt(symbol).binding.load(std::memory_order_acquire) != nullptr; }
+
+    // Calls listener after every write that changes the variable. Returns an id for unsubscribe().
+    SubscriptionId subscribe(Symbol symbol, Listener listener) {
+        std::lock_guard<std::mutex> lock(listenerMutex);
+        listeners[symbol].emplace_back(nextSubscription, std::make_shared<const Listener>(std::move(listener)));
+        listening.store(true, std::memory_order_relaxed);
+        return nextSubscription++;
+    }
+
+    // Calls listener for every changed variable of every write. Returns an id for unsubscribe().
+    SubscriptionId subscribe(Listener listener) {
+        std::lock_guard<std::mutex> lock(listenerMutex);
+        tableListeners.emplace_back(nextSubscription, std::make_shared<const Listener>(std::move(listener)));
+        listening.store(true, std::memory_order_relaxed);
+        return nextSubscription++;
+    }
+
+    // Removes a subscription. The listener may still be running for a write that completed just before.
+    void unsubscribe(SubscriptionId id) {
+        std::lock_guard<std::mutex> lock(listenerMutex);
+        auto remove = [id](Subscriptions &subscriptions) {
+            for (auto it = subscriptions.begin(); it != subscriptions.end(); ++it) {
+                if (it->first == id) {
+                    subscriptions.erase(it);
+                    return true;
+                }
+            }
+            return false;
+        };
+        if (!remove(tableListeners)) {
+            for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+                if (remove(it->second)) {
+                    if (it->second.empty()) {
+                        listeners.erase(it);
+                    }
+                    break;
+                }
+            }
+        }
+        listening.store(!tableListeners.empty() || !listeners.empty(), std::memory_order_relaxed);
+    }
+
+    // Returns a handle to the variable called name, registering the name the first time.
+    Handle registerVariable(std::string_view name) { return Handle(*this, intern(name)); }
+
+    // Runs function, which should only read variables, against a consistent snapshot: it is rerun until no
+    // write overlapped it. Returns its (non-void) result.
+    template <typename Function> auto read(Function function) const -> decltype(function()) {
+        for (;;) {
+            std::uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto result = function();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                return result;
+            }
+        }
+    }
+
+    // Applies update(Writer &) as one atomic change, then calls the listeners of what it changed.
+    template <typename Update> void write(Update update) {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        pendingVersion = version.load(std::memory_order_relaxed) + 1;
+        pendingChange = pendingClear = false;
+        pendingChanges.clear();
+        // Writers are serialized by the mutex, so plain stores are enough to advance the sequence.
+        std::uint64_t odd = sequence.load(std::memory_order_relaxed) + 1;
+        sequence.store(odd, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Writer writer(*this);
+        try {
+            update(writer);
+        } catch (...) {
+            if (pendingChange) {
+                version.store(pendingVersion, std::memory_order_release);
+            }
+            sequence.store(odd + 1, std::memory_order_release);
+            throw;
+        }
+        if (!pendingChange) {
+            sequence.store(odd + 1, std::memory_order_release);
+            return;
+        }
+        version.store(pendingVersion, std::memory_order_release);
+        sequence.store(odd + 1, std::memory_order_release);
+        if ((pendingChanges.empty() && !pendingClear) || !listening.load(std::memory_order_relaxed)) {
+            return;
+        }
+        std::vector<Symbol> changes;
+        changes.swap(pendingChanges);
+        bool cleared = pendingClear;
+        std::uint64_t writeVersion = pendingVersion;
+        lock.unlock();
+        notify(changes, cleared, writeVersion);
+    }
+
+    // Sets a single variable.
+    void set(std::string_view name, double value) {
+        write([&](Writer &writer) { writer.set(name, value); });
+    }
+
+    // Sets a single variable by symbol.
+    void set(Symbol symbol, double value) {
+        write([&](Writer &writer) { writer.set(symbol, value); });
+    }
+
+    // Sets count variables, handles[i] to values[i], as one update.
+    void set(const Handle *handles, const double *values, std::size_t count) {
+        write([&](Writer &writer) {
+            for (std::size_t i = 0; i < count; ++i) {
+                writer.set(handles[i], values[i]);
+            }
+        });
+    }
+
+    // Binds a single variable to a caller-owned double.
+    void bind(std::string_view name, const double *address) {
+        write([&](Writer &writer) { writer.bind(name, address); });
+    }
+
+    // Binds a single variable to a field of a caller-owned object; see Writer::bindField.
+    void bindField(std::string_view name, const void *const *object, std::size_t offset) {
+        write([&](Writer &writer) { writer.bindField(name, object, offset); });
+    }
+
+    // Makes every variable undefined.
+    void clear() {
+        write([](Writer &writer) { writer.clear(); });
+    }
+};
+
+// Handle to one variable of a VariableStore.
+using VariableHandle = VariableStore::Handle;